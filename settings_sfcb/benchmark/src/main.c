@@ -0,0 +1,296 @@
+/*
+ * Copyright (c) 2019 Laczen
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Settings sfcb benchmark: for each key count the file system is filled with
+ * keys of three subtrees (small application values, bluetooth keys and
+ * network credentials), then random updates are done where most updates go
+ * to a small set of hot keys. Each measurement is reported as one csv line:
+ *
+ * bench,keys,updates,op,cnt,us,us_max,flash_rd,flash_wr,flash_er
+ *
+ * op is fill, update, compress (the updates that started a new sector),
+ * load, load_subtree or mount. us is the total time of the cnt operations,
+ * us_max the slowest operation, the flash counters are totals of the cnt
+ * operations.
+ */
+#include <settings_sfcb.h>
+#include <string.h>
+
+#define BENCH_HOT_PCT 80 /* percentage of updates to the hot keys */
+#define BENCH_HOT_DIV 10 /* the first keys / BENCH_HOT_DIV keys are hot */
+
+static const u32_t bench_keys[] = {100, 500, 1000};
+static const u32_t bench_updates[] = {1000, 1000, 1000};
+static u32_t bench_cnt, bench_rnd;
+
+struct bench_op {
+	const char *op;
+	u32_t cnt;
+	u32_t us;
+	u32_t us_max;
+	u32_t rd;
+	u32_t wr;
+	u32_t er;
+};
+
+/* Start of an operation */
+struct bench_mark {
+	u32_t start;
+	u32_t rd;
+	u32_t wr;
+	u32_t er;
+};
+
+static int set(const char *name, size_t len, settings_read_cb read_cb,
+	       void *cb_arg)
+{
+	u8_t value[32];
+
+	(void)read_cb(cb_arg, value, MIN(len, sizeof(value)));
+	bench_cnt++;
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(bm_app, "bmapp", NULL, set, NULL, NULL);
+SETTINGS_STATIC_HANDLER_DEFINE(bm_bt, "bmbt", NULL, set, NULL, NULL);
+SETTINGS_STATIC_HANDLER_DEFINE(bm_net, "bmnet", NULL, set, NULL, NULL);
+
+extern sfcb_fs settings_sfcb;
+
+static u32_t bench_random(void)
+{
+	bench_rnd = bench_rnd * 1103515245U + 12345U;
+	return bench_rnd >> 8;
+}
+
+/* Name and value length of key i: 60% application values of 4 bytes, 30%
+ * bluetooth keys of 16 bytes and 10% network credentials of 32 bytes.
+ */
+static size_t bench_name(u32_t i, char *name, size_t size)
+{
+	u32_t k = i / 10U;
+
+	switch (i % 10U) {
+	case 0:
+		snprintk(name, size, "bmnet/ap%u/psk", k);
+		return 32;
+	case 1:
+	case 2:
+	case 3:
+		snprintk(name, size, "bmbt/keys/c0de%08x/%u", k,
+			 (i % 10U) - 1U);
+		return 16;
+	default:
+		snprintk(name, size, "bmapp/cfg/%u", i);
+		return 4;
+	}
+}
+
+static void bench_init(struct bench_op *op, const char *name)
+{
+	memset(op, 0, sizeof(*op));
+	op->op = name;
+}
+
+static void bench_mark(struct bench_mark *mark)
+{
+	mark->rd = settings_sfcb.stats.flash_rd_cnt;
+	mark->wr = settings_sfcb.stats.flash_wr_cnt;
+	mark->er = settings_sfcb.stats.flash_er_cnt;
+	mark->start = k_cycle_get_32();
+}
+
+/* Add the operation that started at mark to op */
+static void bench_add(struct bench_op *op, const struct bench_mark *mark)
+{
+	u32_t us;
+
+	us = (u32_t)(SYS_CLOCK_HW_CYCLES_TO_NS64(k_cycle_get_32() -
+						 mark->start) / 1000U);
+	op->cnt++;
+	op->us += us;
+	op->us_max = MAX(op->us_max, us);
+	op->rd += settings_sfcb.stats.flash_rd_cnt - mark->rd;
+	op->wr += settings_sfcb.stats.flash_wr_cnt - mark->wr;
+	op->er += settings_sfcb.stats.flash_er_cnt - mark->er;
+}
+
+static void bench_report(struct bench_op *op, u32_t keys, u32_t updates)
+{
+	printk("bench,%u,%u,%s,%u,%u,%u,%u,%u,%u\n", keys, updates, op->op,
+	       op->cnt, op->us, op->us_max, op->rd, op->wr, op->er);
+}
+
+/* Save key i with a value derived from seq */
+static int bench_save(u32_t i, u32_t seq)
+{
+	u8_t value[32];
+	char name[32];
+	size_t len;
+
+	len = bench_name(i, name, sizeof(name));
+	memset(value, (u8_t)seq, len);
+	memcpy(value, &seq, sizeof(seq));
+	return settings_save_one(name, value, len);
+}
+
+/* Store each key once */
+static int bench_fill(u32_t keys, u32_t updates)
+{
+	struct bench_op op;
+	struct bench_mark mark;
+	u32_t i;
+	int rc;
+
+	(void)sfcb_unmount(&settings_sfcb);
+	rc = sfcb_format(&settings_sfcb);
+	if (rc) {
+		return rc;
+	}
+
+	rc = sfcb_mount(&settings_sfcb);
+	if (rc) {
+		return rc;
+	}
+
+	bench_init(&op, "fill");
+	for (i = 0; i < keys; i++) {
+		bench_mark(&mark);
+		rc = bench_save(i, i);
+		if (rc) {
+			return rc;
+		}
+		bench_add(&op, &mark);
+	}
+
+	bench_report(&op, keys, updates);
+	return 0;
+}
+
+/* Random updates, the saves that start a new sector run compress and are
+ * also reported as compress.
+ */
+static int bench_update(u32_t keys, u32_t updates)
+{
+	struct bench_op op, cp;
+	struct bench_mark mark;
+	u32_t n, i, hot;
+	u16_t sector;
+	int rc;
+
+	hot = MAX(keys / BENCH_HOT_DIV, 1U);
+	bench_init(&op, "update");
+	bench_init(&cp, "compress");
+	for (n = 0; n < updates; n++) {
+		if ((bench_random() % 100U) < BENCH_HOT_PCT) {
+			i = bench_random() % hot;
+		} else {
+			i = bench_random() % keys;
+		}
+
+		sector = settings_sfcb.wr_sector;
+		bench_mark(&mark);
+		rc = bench_save(i, keys + n);
+		if (rc) {
+			return rc;
+		}
+		bench_add(&op, &mark);
+		if (settings_sfcb.wr_sector != sector) {
+			bench_add(&cp, &mark);
+		}
+	}
+
+	bench_report(&op, keys, updates);
+	bench_report(&cp, keys, updates);
+	return 0;
+}
+
+static int bench_load(u32_t keys, u32_t updates)
+{
+	struct bench_op op;
+	struct bench_mark mark;
+	int rc;
+
+	bench_init(&op, "load");
+	bench_cnt = 0U;
+	bench_mark(&mark);
+	rc = settings_load();
+	if (rc) {
+		return rc;
+	}
+	bench_add(&op, &mark);
+	if (bench_cnt != keys) {
+		printk("%u keys: %u loaded\n", keys, bench_cnt);
+		return -EIO;
+	}
+	bench_report(&op, keys, updates);
+
+	bench_init(&op, "load_subtree");
+	bench_mark(&mark);
+	rc = settings_load_subtree("bmnet");
+	if (rc) {
+		return rc;
+	}
+	bench_add(&op, &mark);
+	bench_report(&op, keys, updates);
+	return 0;
+}
+
+static int bench_mount(u32_t keys, u32_t updates)
+{
+	struct bench_op op;
+	struct bench_mark mark;
+	int rc;
+
+	bench_init(&op, "mount");
+	(void)sfcb_unmount(&settings_sfcb);
+	bench_mark(&mark);
+	rc = sfcb_mount(&settings_sfcb);
+	if (rc) {
+		return rc;
+	}
+	bench_add(&op, &mark);
+	bench_report(&op, keys, updates);
+	return 0;
+}
+
+// entry point
+int main(void)
+{
+	int rc;
+	u32_t i, keys, updates;
+
+	rc = settings_subsys_init();
+	if (rc) {
+		goto END;
+	}
+
+	printk("bench,keys,updates,op,cnt,us,us_max,flash_rd,flash_wr,"
+	       "flash_er\n");
+	for (i = 0; i < ARRAY_SIZE(bench_keys); i++) {
+		keys = bench_keys[i];
+		updates = bench_updates[i];
+		bench_rnd = 1U;
+		rc = bench_fill(keys, updates);
+		if (!rc) {
+			rc = bench_update(keys, updates);
+		}
+		if (!rc) {
+			rc = bench_load(keys, updates);
+		}
+		if (!rc) {
+			rc = bench_mount(keys, updates);
+		}
+		if (rc) {
+			goto END;
+		}
+	}
+
+END:
+	printk("benchmark %s (%d)\n", rc ? "failed" : "done", rc);
+	return 0;
+}
@@ -18,9 +18,75 @@ extern "C" {
 
 #define SETTINGS_SFCB_ID 0xffff
 
+#if defined(CONFIG_SETTINGS_SFCB_SUBTREE_IDS)
+/* Settings of a top-level subtree with hash h are stored with id
+ * SETTINGS_SFCB_SUBTREE_ID(h), the ids are just below SETTINGS_SFCB_ID.
+ */
+#define SETTINGS_SFCB_SUBTREE_ID(h) \
+	(SETTINGS_SFCB_ID - CONFIG_SETTINGS_SFCB_SUBTREE_ID_CNT + \
+	 ((h) % CONFIG_SETTINGS_SFCB_SUBTREE_ID_CNT))
+#endif
+
+#if defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+/* The value of name k is stored with id SETTINGS_SFCB_VALUE_ID(k), the name
+ * itself (the dictionary record) with id SETTINGS_SFCB_NAME_ID(k).
+ */
+#define SETTINGS_SFCB_VALUE_ID(k) (CONFIG_SETTINGS_SFCB_NAME_ID_BASE + (k))
+#define SETTINGS_SFCB_NAME_ID(k) \
+	(CONFIG_SETTINGS_SFCB_NAME_ID_BASE + CONFIG_SETTINGS_SFCB_NAME_MAX + (k))
+
+BUILD_ASSERT_MSG(CONFIG_SETTINGS_SFCB_NAME_ID_BASE +
+		 2 * CONFIG_SETTINGS_SFCB_NAME_MAX <= SETTINGS_SFCB_ID,
+		 "Settings sfcb name ids overlap SETTINGS_SFCB_ID");
+
+struct settings_sfcb_name {
+	u32_t hash;	/* crc32 of the name */
+	u32_t seq;	/* sfcb sequence number of the newest name record */
+	u32_t last;	/* index of the newest value record (used by load) */
+	u16_t sector;	/* sector of the newest name record */
+	bool used;
+};
+#endif /* defined(CONFIG_SETTINGS_SFCB_NAME_DICT) */
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+struct settings_sfcb_cache_entry {
+	char name[SETTINGS_MAX_NAME_LEN + 1];
+	u8_t value[CONFIG_SETTINGS_SFCB_CACHE_VAL_MAX];
+	size_t val_len;
+	bool dirty;
+};
+#endif /* defined(CONFIG_SETTINGS_SFCB_CACHE) */
+
+#if (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0)
+struct settings_sfcb_lookup {
+	u32_t hash;	/* crc32 of the name */
+	u32_t seq;	/* sfcb sequence number of the record */
+	u32_t used;	/* lookup count at the last use, 0 is unused */
+	sfcb_loc loc;	/* newest record of the name */
+};
+#endif
+
 struct settings_sfcb {
 	struct settings_store cf_store;
 	sfcb_fs *cf_sfcb;
+#if defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+	bool dict_valid;
+	u16_t dict_sector_id;
+	struct settings_sfcb_name dict[CONFIG_SETTINGS_SFCB_NAME_MAX];
+#endif
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+	struct k_mutex cache_lock;
+	struct k_delayed_work cache_work;
+	struct settings_sfcb_cache_entry cache[CONFIG_SETTINGS_SFCB_CACHE_SIZE];
+#endif
+#if (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0)
+	u32_t lookup_cnt;
+	struct settings_sfcb_lookup lookup[CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE];
+#endif
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+	const char *cf_subtree;		/* top-level subtree routed here */
+	struct settings_sfcb *cf_route;	/* next routed instance */
+#endif
 };
 
 /* register sfcb to be a source of settings */
@@ -32,6 +98,27 @@ int settings_sfcb_dst(struct settings_sfcb *cf);
 /* Initialize a sfcb backend. */
 int settings_sfcb_backend_init(struct settings_sfcb *cf);
 
+/* Load the setting name without a load of all settings, cb is called as by
+ * settings_load_subtree_direct(name, cb, param) with key NULL. Returns the
+ * result of cb or -ENOENT when name is not stored.
+ */
+int settings_sfcb_load_direct(struct settings_sfcb *cf, const char *name,
+			      settings_load_direct_cb cb, void *param);
+
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+/* Store the settings of the top-level subtree (e.g. "bt") in cf instead of in
+ * the destination dst, cf is registered as a source of settings. The backend
+ * of cf is initialized by the caller, subtree should remain valid.
+ */
+int settings_sfcb_route(struct settings_sfcb *dst, struct settings_sfcb *cf,
+			const char *subtree);
+#endif
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+/* Write the values in the write-back cache to flash, call before shutdown. */
+int settings_sfcb_flush(struct settings_sfcb *cf);
+#endif
+
 
 #if defined(CONFIG_SETTINGS_SFCB_DEFAULT)
 int settings_backend_init(void);
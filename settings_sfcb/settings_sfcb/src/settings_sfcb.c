@@ -7,6 +7,7 @@
 
 #include <errno.h>
 #include <string.h>
+#include <sys/byteorder.h>
 
 #include <settings_sfcb.h>
 
@@ -17,15 +18,28 @@ struct settings_sfcb_read_fn_arg {
 	sfcb_loc loc;
 };
 
+#if defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+static int settings_sfcb_dict_load(struct settings_store *cs,
+				   const struct settings_load_arg *arg);
+static int settings_sfcb_dict_save(struct settings_store *cs,
+				   const char *name, const char *value,
+				   size_t val_len);
+
+static struct settings_store_itf settings_sfcb_store_itf = {
+	.csi_load = settings_sfcb_dict_load,
+	.csi_save = settings_sfcb_dict_save,
+};
+#else
 static int settings_sfcb_load(struct settings_store *cs,
 			      const struct settings_load_arg *arg);
 static int settings_sfcb_save(struct settings_store *cs, const char *name,
 			     const char *value, size_t val_len);
 
-static struct settings_store_itf settings_sfcb_itf = {
+static struct settings_store_itf settings_sfcb_store_itf = {
 	.csi_load = settings_sfcb_load,
 	.csi_save = settings_sfcb_save,
 };
+#endif /* defined(CONFIG_SETTINGS_SFCB_NAME_DICT) */
 
 static ssize_t settings_sfcb_read_fn(void *back_end, void *data, size_t len)
 {
@@ -38,6 +52,248 @@ static ssize_t settings_sfcb_read_fn(void *back_end, void *data, size_t len)
 	return rc;
 }
 
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+/* Is the top-level subtree of name equal to subtree */
+static bool settings_sfcb_in_subtree(const char *name, const char *subtree)
+{
+	int len;
+
+	len = settings_name_next(name, NULL);
+	return ((strlen(subtree) == len) && (!strncmp(name, subtree, len)));
+}
+
+/* Returns the instance that stores name: the instance the top-level subtree
+ * of name is routed to or cf itself.
+ */
+static struct settings_sfcb *settings_sfcb_route_find(struct settings_sfcb *cf,
+						      const char *name)
+{
+	struct settings_sfcb *rt;
+
+	for (rt = cf->cf_route; rt; rt = rt->cf_route) {
+		if (settings_sfcb_in_subtree(name, rt->cf_subtree)) {
+			return rt;
+		}
+	}
+	return cf;
+}
+
+/* Is name stored in cf, records of a subtree that were written before it was
+ * routed to another instance are ignored.
+ */
+static bool settings_sfcb_stored_here(struct settings_sfcb *cf,
+				      const char *name)
+{
+	if (cf->cf_subtree) {
+		return settings_sfcb_in_subtree(name, cf->cf_subtree);
+	}
+	return (settings_sfcb_route_find(cf, name) == cf);
+}
+#else
+static inline bool settings_sfcb_stored_here(struct settings_sfcb *cf,
+					     const char *name)
+{
+	return true;
+}
+#endif /* defined(CONFIG_SETTINGS_SFCB_ROUTE) */
+
+/* Can cf hold settings of the load, a load of a subtree skips the instances
+ * that do not store the subtree.
+ */
+static bool settings_sfcb_load_here(struct settings_sfcb *cf,
+				    const struct settings_load_arg *arg)
+{
+	if ((!arg) || (!arg->subtree) || (arg->subtree[0] == '\0')) {
+		return true;
+	}
+	return settings_sfcb_stored_here(cf, arg->subtree);
+}
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+/*
+ * Write-back cache: saves of small values are kept in RAM and only the last
+ * value of each name is written to flash when the cache is flushed. The cache
+ * is flushed CONFIG_SETTINGS_SFCB_CACHE_DELAY ms after the first save to a
+ * clean cache, when it is full, before a load, at the end of settings_save(),
+ * on settings_commit() and on a call to settings_sfcb_flush().
+ */
+static struct settings_sfcb *settings_sfcb_cache_dst;
+
+/* Write the dirty entries to flash, the cache lock is held by the caller */
+static int settings_sfcb_cache_flush(struct settings_sfcb *cf)
+{
+	struct settings_sfcb_cache_entry *entry;
+	int rc;
+
+	for (entry = cf->cache; entry < cf->cache + ARRAY_SIZE(cf->cache);
+	     entry++) {
+		if (!entry->dirty) {
+			continue;
+		}
+
+		rc = settings_sfcb_store_itf.csi_save(&cf->cf_store,
+			entry->name, (const char *)entry->value,
+			entry->val_len);
+		if (rc) {
+			return rc;
+		}
+
+		entry->dirty = false;
+	}
+
+	return 0;
+}
+
+int settings_sfcb_flush(struct settings_sfcb *cf)
+{
+	int rc;
+
+	k_mutex_lock(&cf->cache_lock, K_FOREVER);
+	(void)k_delayed_work_cancel(&cf->cache_work);
+	rc = settings_sfcb_cache_flush(cf);
+	k_mutex_unlock(&cf->cache_lock);
+	return rc;
+}
+
+static void settings_sfcb_cache_work(struct k_work *work)
+{
+	struct settings_sfcb *cf;
+	int rc;
+
+	cf = CONTAINER_OF(work, struct settings_sfcb, cache_work);
+	k_mutex_lock(&cf->cache_lock, K_FOREVER);
+	rc = settings_sfcb_cache_flush(cf);
+	k_mutex_unlock(&cf->cache_lock);
+	if (rc) {
+		LOG_ERR("Cache flush failed [%d]", rc);
+	}
+}
+
+static int settings_sfcb_cache_commit(void)
+{
+	struct settings_sfcb *cf;
+	int rc = 0;
+
+	for (cf = settings_sfcb_cache_dst; cf; ) {
+		if (settings_sfcb_flush(cf)) {
+			rc = -EIO;
+		}
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+		cf = cf->cf_route;
+#else
+		cf = NULL;
+#endif
+	}
+	return rc;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(settings_sfcb_cache, "settings_sfcb", NULL,
+			       NULL, settings_sfcb_cache_commit, NULL);
+
+static int settings_sfcb_cache_load(struct settings_store *cs,
+				    const struct settings_load_arg *arg)
+{
+	struct settings_sfcb *cf = (struct settings_sfcb *)cs;
+	int rc;
+
+	/* pending values are written first so load sees them, the lock is
+	 * kept during load as a flush can compress, which uses the load table
+	 */
+	k_mutex_lock(&cf->cache_lock, K_FOREVER);
+	(void)k_delayed_work_cancel(&cf->cache_work);
+	rc = settings_sfcb_cache_flush(cf);
+	if (rc) {
+		LOG_ERR("Cache flush failed [%d]", rc);
+	}
+
+	rc = settings_sfcb_store_itf.csi_load(cs, arg);
+	k_mutex_unlock(&cf->cache_lock);
+	return rc;
+}
+
+static int settings_sfcb_cache_save(struct settings_store *cs,
+				    const char *name, const char *value,
+				    size_t val_len)
+{
+	struct settings_sfcb *cf = (struct settings_sfcb *)cs;
+	struct settings_sfcb_cache_entry *entry, *empty = NULL, *found = NULL;
+	bool clean = true;
+	int rc = 0;
+
+	if (!name) {
+		return -EINVAL;
+	}
+
+	k_mutex_lock(&cf->cache_lock, K_FOREVER);
+	for (entry = cf->cache; entry < cf->cache + ARRAY_SIZE(cf->cache);
+	     entry++) {
+		if (!entry->dirty) {
+			empty = (empty) ? empty : entry;
+			continue;
+		}
+
+		clean = false;
+		if (!strcmp(entry->name, name)) {
+			found = entry;
+		}
+	}
+
+	if ((strlen(name) >= sizeof(cf->cache[0].name)) ||
+	    (val_len > sizeof(cf->cache[0].value))) {
+		/* not cached, this value replaces a cached value */
+		if (found) {
+			found->dirty = false;
+		}
+
+		rc = settings_sfcb_store_itf.csi_save(cs, name, value,
+						      val_len);
+		goto END;
+	}
+
+	if (!found) {
+		found = empty;
+	}
+
+	if (!found) {
+		rc = settings_sfcb_cache_flush(cf);
+		if (rc) {
+			goto END;
+		}
+
+		found = cf->cache;
+	}
+
+	strcpy(found->name, name);
+	if (val_len) {
+		memcpy(found->value, value, val_len);
+	}
+	found->val_len = val_len;
+	found->dirty = true;
+
+	if ((clean) && (CONFIG_SETTINGS_SFCB_CACHE_DELAY > 0)) {
+		(void)k_delayed_work_submit(&cf->cache_work,
+				K_MSEC(CONFIG_SETTINGS_SFCB_CACHE_DELAY));
+	}
+
+END:
+	k_mutex_unlock(&cf->cache_lock);
+	return rc;
+}
+
+static int settings_sfcb_cache_save_end(struct settings_store *cs)
+{
+	return settings_sfcb_flush((struct settings_sfcb *)cs);
+}
+
+static struct settings_store_itf settings_sfcb_itf = {
+	.csi_load = settings_sfcb_cache_load,
+	.csi_save = settings_sfcb_cache_save,
+	.csi_save_end = settings_sfcb_cache_save_end,
+};
+#else
+#define settings_sfcb_itf settings_sfcb_store_itf
+#endif /* defined(CONFIG_SETTINGS_SFCB_CACHE) */
+
 int settings_sfcb_src(struct settings_sfcb *cf)
 {
 	cf->cf_store.cs_itf = &settings_sfcb_itf;
@@ -46,95 +302,1077 @@ int settings_sfcb_src(struct settings_sfcb *cf)
 	return 0;
 }
 
-static int settings_sfcb_compress(sfcb_fs *fs);
+#if defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+static int settings_sfcb_dict_compress(sfcb_fs *fs);
+#else
+static int settings_sfcb_compress(sfcb_fs *fs);
+#endif
+
+/* Destination requires a compress routine */
+static void settings_sfcb_compress_init(struct settings_sfcb *cf)
+{
+#if defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+	cf->cf_sfcb->compress = &settings_sfcb_dict_compress;
+#else
+	cf->cf_sfcb->compress = &settings_sfcb_compress;
+#endif
+}
+
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+/*
+ * The destination uses the route interface when subtrees are routed, saves
+ * are passed to the instance that stores the subtree. The routed instances
+ * are registered as sources themselves, so a load visits all instances.
+ */
+static int settings_sfcb_route_load(struct settings_store *cs,
+				    const struct settings_load_arg *arg)
+{
+	return settings_sfcb_itf.csi_load(cs, arg);
+}
+
+static int settings_sfcb_route_save(struct settings_store *cs,
+				    const char *name, const char *value,
+				    size_t val_len)
+{
+	struct settings_sfcb *cf = (struct settings_sfcb *)cs;
+
+	if (!name) {
+		return -EINVAL;
+	}
+
+	cf = settings_sfcb_route_find(cf, name);
+	return settings_sfcb_itf.csi_save(&cf->cf_store, name, value, val_len);
+}
+
+static int settings_sfcb_route_save_end(struct settings_store *cs)
+{
+	struct settings_sfcb *cf;
+	int rc = 0;
+
+	if (!settings_sfcb_itf.csi_save_end) {
+		return 0;
+	}
+
+	for (cf = (struct settings_sfcb *)cs; cf; cf = cf->cf_route) {
+		if (settings_sfcb_itf.csi_save_end(&cf->cf_store)) {
+			rc = -EIO;
+		}
+	}
+	return rc;
+}
+
+static struct settings_store_itf settings_sfcb_route_itf = {
+	.csi_load = settings_sfcb_route_load,
+	.csi_save = settings_sfcb_route_save,
+	.csi_save_end = settings_sfcb_route_save_end,
+};
+
+int settings_sfcb_route(struct settings_sfcb *dst, struct settings_sfcb *cf,
+			const char *subtree)
+{
+	if ((!subtree) || (subtree[0] == '\0') ||
+	    (settings_name_next(subtree, NULL) != strlen(subtree)) ||
+	    (cf == dst) || (cf->cf_subtree)) {
+		return -EINVAL;
+	}
+
+	if (settings_sfcb_route_find(dst, subtree) != dst) {
+		return -EEXIST;
+	}
+
+	cf->cf_subtree = subtree;
+	cf->cf_route = dst->cf_route;
+	dst->cf_route = cf;
+	dst->cf_store.cs_itf = &settings_sfcb_route_itf;
+	settings_sfcb_compress_init(cf);
+
+	return settings_sfcb_src(cf);
+}
+#endif /* defined(CONFIG_SETTINGS_SFCB_ROUTE) */
+
+int settings_sfcb_dst(struct settings_sfcb *cf)
+{
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+	cf->cf_store.cs_itf = (cf->cf_route) ? &settings_sfcb_route_itf :
+					       &settings_sfcb_itf;
+#else
+	cf->cf_store.cs_itf = &settings_sfcb_itf;
+#endif
+	settings_dst_register(&cf->cf_store);
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+	settings_sfcb_cache_dst = cf;
+#endif
+	settings_sfcb_compress_init(cf);
+
+	return 0;
+}
+
+#if !defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+/*
+ * A framed record starts with a header: SETTINGS_SFCB_FRAME_V1, the name
+ * length and a 16 bit name check (little endian). The name and the value
+ * follow the header. A name never starts with SETTINGS_SFCB_FRAME_V1, records
+ * that start differently are "name=value" records.
+ */
+#define SETTINGS_SFCB_FRAME_V1 0x01
+#define SETTINGS_SFCB_FRAME_HDR_LEN 4
+
+#if defined(CONFIG_SETTINGS_SFCB_SUBTREE_IDS)
+/* Returns the sfcb id for name, derived from its top-level subtree */
+static u16_t settings_sfcb_name_id(const char *name)
+{
+	int len;
+
+	len = settings_name_next(name, NULL);
+	return SETTINGS_SFCB_SUBTREE_ID(crc32_ieee((const u8_t *)name, len));
+}
+
+static inline bool settings_sfcb_is_settings(u16_t id)
+{
+	return ((id >= SETTINGS_SFCB_SUBTREE_ID(0)) &&
+		(id <= SETTINGS_SFCB_ID));
+}
+#else
+static inline u16_t settings_sfcb_name_id(const char *name)
+{
+	return SETTINGS_SFCB_ID;
+}
+
+static inline bool settings_sfcb_is_settings(u16_t id)
+{
+	return (id == SETTINGS_SFCB_ID);
+}
+#endif /* defined(CONFIG_SETTINGS_SFCB_SUBTREE_IDS) */
+
+/* Is the record with id part of a load, load_id is the id of the subtree that
+ * is loaded or SETTINGS_SFCB_ID when all settings are loaded. Records with
+ * SETTINGS_SFCB_ID can belong to any subtree.
+ */
+static bool settings_sfcb_in_load(u16_t id, u16_t load_id)
+{
+	if (!settings_sfcb_is_settings(id)) {
+		return false;
+	}
+
+	return ((load_id == SETTINGS_SFCB_ID) || (id == load_id) ||
+		(id == SETTINGS_SFCB_ID));
+}
+
+static u16_t settings_sfcb_name_check(const char *name, size_t len)
+{
+	u32_t fnv = 0x811c9dc5;
+	size_t i;
+
+	for (i = 0; i < len; i++) {
+		fnv = (fnv ^ (u8_t)name[i]) * 0x01000193;
+	}
+
+	return (u16_t)((fnv >> 16) ^ fnv);
+}
+
+/**
+ * @brief settings_sfcb_read_name
+ *
+ * Reads the name from a location and returns the name length, on return the
+ * location is positioned at the start of the value.
+ *
+ * @param loc: Pointer to location
+ * @param name: buffer to store name in
+ * @param name buffer length
+ * @param val_len: Pointer to value length
+ * @retval >=0: OK
+ * @retval < 0: -ERRCODE
+ */
+static int settings_sfcb_read_name(sfcb_loc *loc, char *name, size_t len,
+				   size_t *val_len)
+{
+	ssize_t rc, i;
+	size_t rec_len = sfcb_get_ate(loc)->len;
+
+	/* When framed records are written only the header is read first */
+	(void)sfcb_rewind_loc(loc);
+	rc = sfcb_read_loc(loc, name,
+			   IS_ENABLED(CONFIG_SETTINGS_SFCB_FRAMED) ?
+			   SETTINGS_SFCB_FRAME_HDR_LEN : len);
+	if (rc < 0) {
+		return rc;
+	}
+
+	if ((rc >= SETTINGS_SFCB_FRAME_HDR_LEN) &&
+	    (name[0] == SETTINGS_SFCB_FRAME_V1)) {
+		i = (u8_t)name[1];
+		if ((i >= len) || (SETTINGS_SFCB_FRAME_HDR_LEN + i > rec_len)) {
+			return -ENODATA;
+		}
+
+		/* part of the name might already be read */
+		rc = MIN(rc - SETTINGS_SFCB_FRAME_HDR_LEN, i);
+		memmove(name, name + SETTINGS_SFCB_FRAME_HDR_LEN, rc);
+		(void)sfcb_setpos_loc(loc, SETTINGS_SFCB_FRAME_HDR_LEN + rc);
+		if (rc < i) {
+			rc = sfcb_read_loc(loc, name + rc, i - rc);
+			if (rc < 0) {
+				return rc;
+			}
+		}
+
+		name[i] = '\0';
+		*val_len = rec_len - SETTINGS_SFCB_FRAME_HDR_LEN - i;
+		return i;
+	}
+
+	if ((rc < len) && (rc < rec_len)) {
+		i = sfcb_read_loc(loc, name + rc, len - rc);
+		if (i < 0) {
+			return i;
+		}
+		rc += i;
+	}
+
+	for (i = 0; i < rc; i++) {
+		if (name[i] == '=') {
+			name[i] = '\0';
+			break;
+		}
+	}
+
+	if (i == rc) {
+		return -ENODATA;
+	}
+
+	(void)sfcb_setpos_loc(loc, i + 1);
+	*val_len = rec_len - i - 1;
+	return i;
+}
+
+struct settings_sfcb_match_arg {
+	const char *name;
+	size_t name_len;
+	size_t val_len;	/* value length of the record that matches */
+	u16_t check;
+	u16_t id;
+};
+
+static void settings_sfcb_match_init(struct settings_sfcb_match_arg *arg,
+				     const char *name)
+{
+	arg->name = name;
+	arg->name_len = strlen(name);
+	arg->check = settings_sfcb_name_check(name, arg->name_len);
+	arg->id = settings_sfcb_name_id(name);
+}
+
+/**
+ * @brief settings_sfcb_match_name
+ *
+ * Checks if the record at loc uses the name of arg, the read position is then
+ * at the start of the value. Records of other subtrees and framed records
+ * with a different name length or name check are skipped without reading the
+ * name.
+ *
+ * @param loc: Pointer to location
+ * @param arg: Pointer to struct settings_sfcb_match_arg
+ * @retval true: the record uses name
+ * @retval false: the record does not use name
+ */
+static bool settings_sfcb_match_name(sfcb_loc *loc, void *arg)
+{
+	struct settings_sfcb_match_arg *m = arg;
+	u8_t name1[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
+	u8_t hdr[SETTINGS_SFCB_FRAME_HDR_LEN];
+	size_t val_len;
+
+	if (!settings_sfcb_in_load(sfcb_get_ate(loc)->id, m->id)) {
+		return false;
+	}
+
+	if ((IS_ENABLED(CONFIG_SETTINGS_SFCB_FRAMED)) &&
+	    (sfcb_read_loc(loc, hdr, sizeof(hdr)) == sizeof(hdr)) &&
+	    (hdr[0] == SETTINGS_SFCB_FRAME_V1) &&
+	    ((hdr[1] != m->name_len) || (sys_get_le16(&hdr[2]) != m->check))) {
+		return false;
+	}
+
+	if ((settings_sfcb_read_name(loc, name1, sizeof(name1),
+				     &val_len) <= 0) ||
+	    (strcmp(m->name, name1))) {
+		return false;
+	}
+
+	m->val_len = val_len;
+	return true;
+}
+
+/**
+ * @brief settings_sfcb_next_name
+ *
+ * Moves loc to the next entry that uses name, the read position is then at
+ * the start of the value.
+ *
+ * @param loc: Pointer to location
+ * @param val_len: Pointer to value length of the entry found
+ * @retval 0: an entry with name is found
+ * @retval -ENOENT: no further entry with name
+ */
+static int settings_sfcb_next_name(sfcb_loc *loc, const char *name,
+				   size_t *val_len)
+{
+	struct settings_sfcb_match_arg arg;
+
+	settings_sfcb_match_init(&arg, name);
+	while (!sfcb_next_loc(loc)) {
+		if (settings_sfcb_match_name(loc, &arg)) {
+			*val_len = arg.val_len;
+			return 0;
+		}
+	}
+	return -ENOENT;
+}
+
+/**
+ * @brief settings_sfcb_check_duplicate
+ *
+ * Searches for entries that use the same name, starting from loc
+ *
+ * @param loc: Pointer to location
+ * @retval true: a later entry with the same name exists
+ * @retval false: a later entry with the same name does not exist
+ */
+static bool settings_sfcb_check_duplicate(const sfcb_loc *loc,
+	const char * const name)
+{
+	sfcb_loc loc1;
+	size_t val_len;
+
+	loc1 = *loc;
+	return (settings_sfcb_next_name(&loc1, name, &val_len) == 0);
+}
+
+#if (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0)
+/*
+ * Lookup cache: the location of the newest record of recently found names.
+ * An entry is valid while the sector of the record is not erased (the
+ * sequence number of the location is unchanged), a save of the name removes
+ * the entry. The name of the record is read again to rule out a hash
+ * collision.
+ */
+static struct settings_sfcb_lookup *
+settings_sfcb_lookup_get(struct settings_sfcb *cf, u32_t hash)
+{
+	struct settings_sfcb_lookup *entry;
+
+	for (entry = cf->lookup;
+	     entry < cf->lookup + CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE;
+	     entry++) {
+		if ((entry->used) && (entry->hash == hash)) {
+			return entry;
+		}
+	}
+	return NULL;
+}
+
+static int settings_sfcb_lookup_find(struct settings_sfcb *cf,
+				     const char *name, u32_t hash,
+				     sfcb_loc *loc, size_t *val_len)
+{
+	struct settings_sfcb_lookup *entry;
+	char name1[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
+	u32_t seq;
+
+	entry = settings_sfcb_lookup_get(cf, hash);
+	if (!entry) {
+		return -ENOENT;
+	}
+
+	*loc = entry->loc;
+	if ((sfcb_loc_seq(loc, &seq)) || (seq != entry->seq) ||
+	    (settings_sfcb_read_name(loc, name1, sizeof(name1),
+				     val_len) <= 0) ||
+	    (strcmp(name, name1))) {
+		entry->used = 0U;
+		return -ENOENT;
+	}
+
+	entry->used = ++cf->lookup_cnt;
+	return 0;
+}
+
+/* Add the location to the cache, the least recently used entry is replaced */
+static void settings_sfcb_lookup_add(struct settings_sfcb *cf, u32_t hash,
+				     const sfcb_loc *loc)
+{
+	struct settings_sfcb_lookup *entry, *lru;
+
+	lru = cf->lookup;
+	for (entry = cf->lookup;
+	     entry < cf->lookup + CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE;
+	     entry++) {
+		if (entry->used < lru->used) {
+			lru = entry;
+		}
+	}
+
+	lru->loc = *loc;
+	lru->loc.data_offset = 0U;
+	if (sfcb_loc_seq(&lru->loc, &lru->seq)) {
+		lru->used = 0U;
+		return;
+	}
+	lru->hash = hash;
+	lru->used = ++cf->lookup_cnt;
+}
+
+static void settings_sfcb_lookup_drop(struct settings_sfcb *cf,
+				      const char *name)
+{
+	struct settings_sfcb_lookup *entry;
+
+	entry = settings_sfcb_lookup_get(cf, crc32_ieee((const u8_t *)name,
+							strlen(name)));
+	if (entry) {
+		entry->used = 0U;
+	}
+}
+#else
+static inline void settings_sfcb_lookup_drop(struct settings_sfcb *cf,
+					     const char *name)
+{
+}
+#endif /* CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0 */
+
+/**
+ * @brief settings_sfcb_find
+ *
+ * Finds the newest record of name without a walk of all records: the sectors
+ * are searched from newest to oldest and the search ends in the first sector
+ * that holds the name. The read position is then at the start of the value.
+ *
+ * @param loc: Pointer to location
+ * @param val_len: Pointer to value length of the record found (0 is deleted)
+ * @retval 0: a record with name is found
+ * @retval -ENOENT: name is not stored
+ */
+static int settings_sfcb_find(struct settings_sfcb *cf, const char *name,
+			      sfcb_loc *loc, size_t *val_len)
+{
+	struct settings_sfcb_match_arg arg;
+	int rc;
+#if (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0)
+	u32_t hash;
+
+	hash = crc32_ieee((const u8_t *)name, strlen(name));
+	if (!settings_sfcb_lookup_find(cf, name, hash, loc, val_len)) {
+		return 0;
+	}
+#endif
+
+	settings_sfcb_match_init(&arg, name);
+	rc = sfcb_find_loc(cf->cf_sfcb, loc, settings_sfcb_match_name, &arg);
+	if (rc) {
+		return rc;
+	}
+
+#if (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0)
+	settings_sfcb_lookup_add(cf, hash, loc);
+#endif
+	*val_len = arg.val_len;
+	return sfcb_setpos_loc(loc, sfcb_get_ate(loc)->len - arg.val_len);
+}
+
+#if defined(CONFIG_SETTINGS_SFCB_SKIP_UNCHANGED)
+/* Is the newest value of name equal to value, a delete of a name that is not
+ * stored is also unchanged.
+ */
+static bool settings_sfcb_unchanged(struct settings_sfcb *cf, const char *name,
+				    const char *value, size_t val_len)
+{
+	sfcb_loc loc;
+	size_t len;
+	int rc;
+
+	rc = settings_sfcb_find(cf, name, &loc, &len);
+	if (rc) {
+		return (rc == -ENOENT) && (!val_len);
+	}
+
+	if (len != val_len) {
+		return false;
+	}
+
+	return (sfcb_cmp_loc(&loc, value, val_len) == 0);
+}
+#endif /* defined(CONFIG_SETTINGS_SFCB_SKIP_UNCHANGED) */
+
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+/*
+ * Load table: the first pass over the settings stores for each name hash the
+ * index of the newest record. In the second pass a record is only delivered
+ * (or copied by compress) when it is the newest for its hash. A second hash
+ * (check) is kept to detect different names with the same hash, only for these
+ * names a walk is done to find a later record.
+ */
+struct settings_sfcb_load_entry {
+	u32_t hash;
+	u16_t check;
+	u16_t last;
+	bool used;
+	bool mixed;
+};
+
+static struct settings_sfcb_load_entry
+	settings_sfcb_load_tbl[CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE];
+
+/*
+ * The load table is used by one load or compress at a time. The lock keeps
+ * out other threads, the busy flag a compress started from a set handler of a
+ * load in the same thread. A load or compress that does not get the table
+ * walks the later records instead.
+ */
+static K_MUTEX_DEFINE(settings_sfcb_load_tbl_lock);
+static bool settings_sfcb_load_tbl_busy;
+
+static bool settings_sfcb_load_tbl_get(void)
+{
+	if (k_mutex_lock(&settings_sfcb_load_tbl_lock, K_NO_WAIT)) {
+		return false;
+	}
+
+	if (settings_sfcb_load_tbl_busy) {
+		k_mutex_unlock(&settings_sfcb_load_tbl_lock);
+		return false;
+	}
+
+	settings_sfcb_load_tbl_busy = true;
+	return true;
+}
+
+static void settings_sfcb_load_tbl_put(void)
+{
+	settings_sfcb_load_tbl_busy = false;
+	k_mutex_unlock(&settings_sfcb_load_tbl_lock);
+}
+
+static void settings_sfcb_name_hash(const char *name, size_t len, u32_t *hash,
+				    u16_t *check)
+{
+	*hash = crc32_ieee((const u8_t *)name, len);
+	*check = settings_sfcb_name_check(name, len);
+}
+
+/* Returns the entry for hash or the free entry to use, NULL if full */
+static struct settings_sfcb_load_entry *settings_sfcb_load_find(u32_t hash)
+{
+	struct settings_sfcb_load_entry *entry;
+	size_t i, cnt = CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE;
+
+	i = hash % cnt;
+	while (cnt--) {
+		entry = &settings_sfcb_load_tbl[i];
+		if ((!entry->used) || (entry->hash == hash)) {
+			return entry;
+		}
+		i = (i + 1) % CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE;
+	}
+
+	return NULL;
+}
+
+/* First pass: fill the load table with the records after start, returns
+ * -ENOMEM when it is too small.
+ */
+static int settings_sfcb_load_table(const sfcb_loc *start, u16_t load_id)
+{
+	sfcb_loc loc;
+	sfcb_ate *ate;
+	struct settings_sfcb_load_entry *entry;
+	char name[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
+	int name_len;
+	size_t val_len;
+	u32_t hash, idx = 0;
+	u16_t check;
+
+	memset(settings_sfcb_load_tbl, 0, sizeof(settings_sfcb_load_tbl));
+
+	loc = *start;
+	while (!sfcb_next_loc(&loc)) {
+		ate = sfcb_get_ate(&loc);
+		if (!settings_sfcb_in_load(ate->id, load_id)) {
+			continue;
+		}
+
+		name_len = settings_sfcb_read_name(&loc, name, sizeof(name),
+						   &val_len);
+		if (name_len <= 0) {
+			continue;
+		}
+
+		if (idx > UINT16_MAX) {
+			return -ENOMEM;
+		}
+
+		settings_sfcb_name_hash(name, name_len, &hash, &check);
+		entry = settings_sfcb_load_find(hash);
+		if (!entry) {
+			return -ENOMEM;
+		}
+
+		if ((entry->used) && (entry->check != check)) {
+			entry->mixed = true;
+		}
+
+		entry->hash = hash;
+		entry->check = check;
+		entry->last = (u16_t)idx++;
+		entry->used = true;
+	}
+
+	return 0;
+}
+
+/* Second pass: is a later record with the same name available */
+static bool settings_sfcb_load_duplicate(const sfcb_loc *loc, const char *name,
+					 int name_len, u32_t idx)
+{
+	struct settings_sfcb_load_entry *entry;
+	u32_t hash;
+	u16_t check;
+
+	settings_sfcb_name_hash(name, name_len, &hash, &check);
+	entry = settings_sfcb_load_find(hash);
+	if ((!entry) || (!entry->used) || (entry->last == idx)) {
+		return false;
+	}
+
+	if (!entry->mixed) {
+		return true;
+	}
+
+	return settings_sfcb_check_duplicate(loc, name);
+}
+#endif /* CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0 */
+
+static int settings_sfcb_load(struct settings_store *cs,
+			      const struct settings_load_arg *arg)
+{
+	int rc;
+	struct settings_sfcb *cf = (struct settings_sfcb *)cs;
+	struct settings_sfcb_read_fn_arg read_fn_arg;
+	sfcb_ate *load_ate;
+	char name[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
+	int name_len;
+	size_t val_len;
+	bool duplicate;
+	u16_t load_id = SETTINGS_SFCB_ID;
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+	bool use_tbl;
+	u32_t idx = 0;
+#endif
+
+	if (!settings_sfcb_load_here(cf, arg)) {
+		return 0;
+	}
+
+	if ((arg) && (arg->subtree) && (arg->subtree[0] != '\0')) {
+		load_id = settings_sfcb_name_id(arg->subtree);
+	}
+
+	rc = sfcb_start_loc(cf->cf_sfcb, &read_fn_arg.loc);
+	if (rc) {
+		return rc;
+	}
+
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+	use_tbl = settings_sfcb_load_tbl_get();
+	if ((use_tbl) &&
+	    (settings_sfcb_load_table(&read_fn_arg.loc, load_id))) {
+		settings_sfcb_load_tbl_put();
+		use_tbl = false;
+	}
+#endif
+
+	while (!sfcb_next_loc(&read_fn_arg.loc)) {
+
+		load_ate = sfcb_get_ate(&read_fn_arg.loc);
+		if (!settings_sfcb_in_load(load_ate->id, load_id)) {
+			continue;
+		}
+
+		name_len = settings_sfcb_read_name(&read_fn_arg.loc, name,
+			sizeof(name), &val_len);
+		if (name_len < 0) {
+			continue;
+		}
+
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+		if (use_tbl) {
+			duplicate = (val_len) && (name_len) &&
+				settings_sfcb_load_duplicate(&read_fn_arg.loc,
+							     name, name_len,
+							     idx);
+			if (name_len) {
+				idx++;
+			}
+		} else
+#endif
+		{
+			duplicate = (val_len) &&
+				settings_sfcb_check_duplicate(&read_fn_arg.loc,
+							      name);
+		}
+
+		if ((!val_len) || (duplicate) ||
+		    (!settings_sfcb_stored_here(cf, name))) {
+			continue;
+		}
+
+		/* the read position is at the start of the value */
+		rc = settings_call_set_handler(name, val_len,
+			settings_sfcb_read_fn, &read_fn_arg, (void *)arg);
+		if (rc) {
+			break;
+		}
+	}
+
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+	if (use_tbl) {
+		settings_sfcb_load_tbl_put();
+	}
+#endif
+	return 0;
+}
+
+static int settings_sfcb_save(struct settings_store *cs, const char *name,
+			     const char *value, size_t val_len)
+{
+	struct settings_sfcb *cf = (struct settings_sfcb *)cs;
+	sfcb_loc wr_loc;
+	int rc, nm_len;
+	u8_t hdr[SETTINGS_SFCB_FRAME_HDR_LEN];
+	u16_t id;
+
+	if (!name) {
+		return -EINVAL;
+	}
+
+#if defined(CONFIG_SETTINGS_SFCB_SKIP_UNCHANGED)
+	if (settings_sfcb_unchanged(cf, name, value, val_len)) {
+		sfcb_stats_skip(cf->cf_sfcb);
+		return 0;
+	}
+#endif
+
+	settings_sfcb_lookup_drop(cf, name);
+
+	nm_len = strlen(name);
+	id = settings_sfcb_name_id(name);
+	if ((IS_ENABLED(CONFIG_SETTINGS_SFCB_FRAMED)) && (nm_len <= UINT8_MAX)) {
+		hdr[0] = SETTINGS_SFCB_FRAME_V1;
+		hdr[1] = (u8_t)nm_len;
+		sys_put_le16(settings_sfcb_name_check(name, nm_len), &hdr[2]);
+		rc = sfcb_open_loc(cf->cf_sfcb, &wr_loc, id,
+				   sizeof(hdr) + nm_len + val_len);
+		if (rc) {
+			return rc;
+		}
+		(void)sfcb_write_loc(&wr_loc, hdr, sizeof(hdr));
+		(void)sfcb_write_loc(&wr_loc, name, nm_len);
+		(void)sfcb_write_loc(&wr_loc, value, val_len);
+		return sfcb_close_loc(&wr_loc);
+	}
+
+	rc = sfcb_open_loc(cf->cf_sfcb, &wr_loc, id,
+			   nm_len + 1 + val_len);
+	if (rc) {
+		return rc;
+	}
+	(void)sfcb_write_loc(&wr_loc, name, nm_len);
+	(void)sfcb_write_loc(&wr_loc, "=", 1);
+	(void)sfcb_write_loc(&wr_loc, value, val_len);
+	rc = sfcb_close_loc(&wr_loc);
+	return rc;
+}
+
+/*
+ * Compress copies the newest record of each name in the compression sector
+ * that is not a delete. A delete is only needed while an older sector holds a
+ * record with the name. Without the name dictionary greedy selection is off
+ * (see settings_sfcb_backend_init()), the compression sector is the oldest
+ * sector and deletes are dropped. Should it not be the oldest, all deletes
+ * are copied. With the load table the records after the start of the
+ * compression sector are walked once to find the newest record of each name,
+ * otherwise each record is checked by a walk of the later records.
+ */
+int settings_sfcb_compress(sfcb_fs *fs)
+{
+	int rc;
+	u16_t compress_sector;
+	sfcb_loc loc_compress;
+	sfcb_ate *ate_compress;
+	char name[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
+	int name_len;
+	size_t val_len;
+	bool keep, keep_deletes, duplicate;
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+	bool use_tbl;
+	u32_t idx = 0;
+#endif
+
+	rc = sfcb_compress_sector(fs, &compress_sector);
+	if (rc) {
+		return rc;
+	}
+
+	rc = sfcb_start_loc(fs, &loc_compress);
+	if (rc) {
+		return rc;
+	}
+
+	keep_deletes = (loc_compress.sector != compress_sector);
+
+	rc = sfcb_compress_start_loc(fs, &loc_compress);
+	if (rc) {
+		return rc;
+	}
+
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+	use_tbl = settings_sfcb_load_tbl_get();
+	if ((use_tbl) &&
+	    (settings_sfcb_load_table(&loc_compress, SETTINGS_SFCB_ID))) {
+		settings_sfcb_load_tbl_put();
+		use_tbl = false;
+	}
+#endif
+
+	while (!sfcb_next_loc(&loc_compress)) {
+
+		if (loc_compress.sector != compress_sector) {
+			break;
+		}
+
+		ate_compress = sfcb_get_ate(&loc_compress);
+		if (!settings_sfcb_is_settings(ate_compress->id)) {
+			continue;
+		}
+
+		name_len = settings_sfcb_read_name(&loc_compress, name,
+			sizeof(name), &val_len);
+		if (name_len < 0) {
+			continue;
+		}
+
+		keep = (val_len) || ((name_len) && (keep_deletes));
+
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+		if (use_tbl) {
+			duplicate = (keep) && (name_len) &&
+				settings_sfcb_load_duplicate(&loc_compress,
+							     name, name_len,
+							     idx);
+			if (name_len) {
+				idx++;
+			}
+		} else
+#endif
+		{
+			duplicate = (keep) &&
+				settings_sfcb_check_duplicate(&loc_compress,
+							      name);
+		}
+
+		if ((!keep) || (duplicate)) {
+			continue;
+		}
+
+		rc = sfcb_copy_loc(&loc_compress);
+		if (rc) {
+			break;
+		}
+	}
+
+#if (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0)
+	if (use_tbl) {
+		settings_sfcb_load_tbl_put();
+	}
+#endif
+	return rc;
+}
+
+#else
+static inline bool settings_sfcb_is_value(u16_t id)
+{
+	return ((id >= SETTINGS_SFCB_VALUE_ID(0)) &&
+		(id < SETTINGS_SFCB_VALUE_ID(CONFIG_SETTINGS_SFCB_NAME_MAX)));
+}
+
+static inline bool settings_sfcb_is_name(u16_t id)
+{
+	return ((id >= SETTINGS_SFCB_NAME_ID(0)) &&
+		(id < SETTINGS_SFCB_NAME_ID(CONFIG_SETTINGS_SFCB_NAME_MAX)));
+}
+
+/**
+ * @brief settings_sfcb_dict_read_name
+ *
+ * Reads the name of dictionary entry k as a null terminated string
+ *
+ * @retval >=0: OK, name length
+ * @retval < 0: -ERRCODE
+ */
+static int settings_sfcb_dict_read_name(struct settings_sfcb *cf, u16_t k,
+					char *name, size_t len)
+{
+	int rc;
+	sfcb_loc loc;
+
+	rc = sfcb_seek_seq(cf->cf_sfcb, &loc, cf->dict[k].seq);
+	if (rc) {
+		return rc;
+	}
+
+	rc = sfcb_next_loc(&loc);
+	if (rc) {
+		return rc;
+	}
+
+	if (sfcb_get_ate(&loc)->id != SETTINGS_SFCB_NAME_ID(k)) {
+		return -EIO;
+	}
 
-int settings_sfcb_dst(struct settings_sfcb *cf)
-{
-	cf->cf_store.cs_itf = &settings_sfcb_itf;
-	settings_dst_register(&cf->cf_store);
-	/* Destination requires a compress routine */
-	cf->cf_sfcb->compress = &settings_sfcb_compress;
+	rc = sfcb_read_loc(&loc, name, len - 1);
+	if (rc < 0) {
+		return rc;
+	}
 
-	return 0;
+	name[rc] = '\0';
+	return rc;
 }
 
 /**
- * @brief settings_sfcb_read_name
+ * @brief settings_sfcb_dict_scan
  *
- * Reads the name from a location and returns the name length
+ * Rebuilds the dictionary from the name records and stores the index of the
+ * newest value record for each name.
  *
- * @param loc: Pointer to location
- * @param name: buffer to store name in
- * @param name buffer length
- * @retval >=0: OK
+ * @retval 0: OK
  * @retval < 0: -ERRCODE
  */
-static int settings_sfcb_read_name(sfcb_loc *loc, char *name, size_t len)
+static int settings_sfcb_dict_scan(struct settings_sfcb *cf)
 {
-	ssize_t rc, i;
+	int rc;
+	sfcb_loc loc;
+	sfcb_ate *ate;
+	struct settings_sfcb_name *entry;
+	char name[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
+	u32_t idx = 0;
 
-	rc = sfcb_read_loc(loc, name, len);
-	if (rc < 0) {
+	cf->dict_valid = false;
+	memset(cf->dict, 0, sizeof(cf->dict));
+
+	rc = sfcb_start_loc(cf->cf_sfcb, &loc);
+	if (rc) {
 		return rc;
 	}
 
-	for (i = 0; i < rc; i++) {
-		if (name[i] == '=') {
-			name[i] = '\0';
-			break;
+	while (!sfcb_next_loc(&loc)) {
+		ate = sfcb_get_ate(&loc);
+		if (settings_sfcb_is_value(ate->id)) {
+			entry = &cf->dict[ate->id - SETTINGS_SFCB_VALUE_ID(0)];
+			entry->last = idx++;
+			continue;
+		}
+
+		if (!settings_sfcb_is_name(ate->id)) {
+			continue;
+		}
+
+		entry = &cf->dict[ate->id - SETTINGS_SFCB_NAME_ID(0)];
+		rc = sfcb_read_loc(&loc, name, sizeof(name));
+		if (rc <= 0) {
+			continue;
+		}
+
+		entry->hash = crc32_ieee((const u8_t *)name, rc);
+		entry->sector = loc.sector;
+		entry->used = true;
+		rc = sfcb_loc_seq(&loc, &entry->seq);
+		if (rc) {
+			return rc;
 		}
 	}
 
-	if (i == rc) {
-		return -ENODATA;
+	cf->dict_valid = true;
+	cf->dict_sector_id = cf->cf_sfcb->wr_sector_id;
+	return 0;
+}
+
+/* The dictionary is invalid when the file system has moved to a new sector,
+ * a compress might have moved the name records.
+ */
+static int settings_sfcb_dict_check(struct settings_sfcb *cf)
+{
+	if ((cf->dict_valid) &&
+	    (cf->dict_sector_id == cf->cf_sfcb->wr_sector_id)) {
+		return 0;
 	}
-	return i;
+
+	return settings_sfcb_dict_scan(cf);
 }
 
 /**
- * @brief settings_sfcb_check_duplicate
+ * @brief settings_sfcb_dict_find
  *
- * Searches for entries that use the same name, starting from loc
+ * Searches the dictionary for name.
  *
- * @param loc: Pointer to location
- * @retval true: a later entry with the same name exists
- * @retval false: a later entry with the same name does not exist
+ * @retval >=0: dictionary entry of name
+ * @retval -ENOENT: name is not in the dictionary
+ * @retval < 0: -ERRCODE
  */
-static bool settings_sfcb_check_duplicate(const sfcb_loc *loc,
-	const char * const name)
+static int settings_sfcb_dict_find(struct settings_sfcb *cf, const char *name,
+				   size_t name_len)
 {
-	sfcb_loc loc1;
-
-	loc1 = *loc;
-	while (!sfcb_next_loc(&loc1)) {
-		sfcb_ate *ate1;
-		u8_t name1[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
+	int rc;
+	u16_t k;
+	u32_t hash;
+	char name1[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
 
-		ate1 = sfcb_get_ate(&loc1);
-		if (ate1->id != SETTINGS_SFCB_ID) {
+	hash = crc32_ieee((const u8_t *)name, name_len);
+	for (k = 0; k < CONFIG_SETTINGS_SFCB_NAME_MAX; k++) {
+		if ((!cf->dict[k].used) || (cf->dict[k].hash != hash)) {
 			continue;
 		}
 
-		if (settings_sfcb_read_name(&loc1, name1, sizeof(name1)) <= 0) {
-			continue;
+		rc = settings_sfcb_dict_read_name(cf, k, name1, sizeof(name1));
+		if (rc < 0) {
+			return rc;
 		}
 
 		if (!strcmp(name, name1)) {
-			return true;
+			return k;
 		}
 	}
-	return false;
+
+	return -ENOENT;
 }
 
-static int settings_sfcb_load(struct settings_store *cs,
-			      const struct settings_load_arg *arg)
+static int settings_sfcb_dict_load(struct settings_store *cs,
+				   const struct settings_load_arg *arg)
 {
 	int rc;
 	struct settings_sfcb *cf = (struct settings_sfcb *)cs;
 	struct settings_sfcb_read_fn_arg read_fn_arg;
 	sfcb_ate *load_ate;
 	char name[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
-	int name_len, val_len;
+	u32_t idx = 0;
+	u16_t k;
+
+	if (!settings_sfcb_load_here(cf, arg)) {
+		return 0;
+	}
+
+	rc = settings_sfcb_dict_scan(cf);
+	if (rc) {
+		return rc;
+	}
 
 	rc = sfcb_start_loc(cf->cf_sfcb, &read_fn_arg.loc);
 	if (rc) {
@@ -144,28 +1382,24 @@ static int settings_sfcb_load(struct settings_store *cs,
 	while (!sfcb_next_loc(&read_fn_arg.loc)) {
 
 		load_ate = sfcb_get_ate(&read_fn_arg.loc);
-		if (load_ate->id != SETTINGS_SFCB_ID) {
+		if (!settings_sfcb_is_value(load_ate->id)) {
 			continue;
 		}
 
-		name_len = settings_sfcb_read_name(&read_fn_arg.loc, name,
-			sizeof(name));
-		if (name_len < 0) {
-			continue;
-		}
-
-		val_len = load_ate->len - name_len - 1;
-		if (!val_len) {
+		/* only the newest value of a name is used */
+		k = load_ate->id - SETTINGS_SFCB_VALUE_ID(0);
+		if ((cf->dict[k].last != idx++) || (!load_ate->len) ||
+		    (!cf->dict[k].used)) {
 			continue;
 		}
 
-		if (settings_sfcb_check_duplicate(&read_fn_arg.loc, name)) {
+		if ((settings_sfcb_dict_read_name(cf, k, name,
+						  sizeof(name)) <= 0) ||
+		    (!settings_sfcb_stored_here(cf, name))) {
 			continue;
 		}
 
-		/* set the read position just after '=' */
-		sfcb_setpos_loc(&read_fn_arg.loc, name_len + 1);
-		rc = settings_call_set_handler(name, val_len,
+		rc = settings_call_set_handler(name, load_ate->len,
 			settings_sfcb_read_fn, &read_fn_arg, (void *)arg);
 		if (rc) {
 			break;
@@ -174,82 +1408,373 @@ static int settings_sfcb_load(struct settings_store *cs,
 	return 0;
 }
 
-static int settings_sfcb_save(struct settings_store *cs, const char *name,
-			     const char *value, size_t val_len)
+/**
+ * @brief settings_sfcb_dict_write_name
+ *
+ * Writes the name record of dictionary entry k and updates the entry.
+ *
+ * @retval 0: OK
+ * @retval < 0: -ERRCODE
+ */
+static int settings_sfcb_dict_write_name(struct settings_sfcb *cf, u16_t k,
+					 const char *name, size_t nm_len)
+{
+	sfcb_loc wr_loc;
+	int rc;
+
+	rc = sfcb_open_loc(cf->cf_sfcb, &wr_loc, SETTINGS_SFCB_NAME_ID(k),
+			   nm_len);
+	if (rc) {
+		return rc;
+	}
+	(void)sfcb_write_loc(&wr_loc, name, nm_len);
+	rc = sfcb_close_loc(&wr_loc);
+	if (rc) {
+		return rc;
+	}
+
+	cf->dict[k].used = true;
+	cf->dict[k].hash = crc32_ieee((const u8_t *)name, nm_len);
+	cf->dict[k].sector = wr_loc.sector;
+	rc = sfcb_loc_seq(&wr_loc, &cf->dict[k].seq);
+	if (rc) {
+		cf->dict_valid = false;
+	}
+	return 0;
+}
+
+static int settings_sfcb_dict_save(struct settings_store *cs,
+				   const char *name, const char *value,
+				   size_t val_len)
 {
 	struct settings_sfcb *cf = (struct settings_sfcb *)cs;
 	sfcb_loc wr_loc;
-	int rc, nm_len;
+	int rc, k, nm_len;
+	u16_t compress_sector;
 
 	if (!name) {
 		return -EINVAL;
 	}
 
+	rc = settings_sfcb_dict_check(cf);
+	if (rc) {
+		return rc;
+	}
+
 	nm_len = strlen(name);
-	rc = sfcb_open_loc(cf->cf_sfcb, &wr_loc, SETTINGS_SFCB_ID,
-			   nm_len + 1 + val_len);
+	k = settings_sfcb_dict_find(cf, name, nm_len);
+	if ((k < 0) && (k != -ENOENT)) {
+		return k;
+	}
+
+	if (k == -ENOENT) {
+		if (!val_len) {
+			/* nothing to delete */
+			return 0;
+		}
+
+		for (k = 0; k < CONFIG_SETTINGS_SFCB_NAME_MAX; k++) {
+			if (!cf->dict[k].used) {
+				break;
+			}
+		}
+
+		if (k == CONFIG_SETTINGS_SFCB_NAME_MAX) {
+			return -ENOMEM;
+		}
+
+		rc = settings_sfcb_dict_write_name(cf, k, name, nm_len);
+		if (rc) {
+			return rc;
+		}
+	}
+
+#if defined(CONFIG_SETTINGS_SFCB_SKIP_UNCHANGED)
+	rc = sfcb_write_if_changed(cf->cf_sfcb, SETTINGS_SFCB_VALUE_ID(k),
+				   value, val_len);
+	if (rc < 0) {
+		return rc;
+	}
+#else
+	rc = sfcb_open_loc(cf->cf_sfcb, &wr_loc, SETTINGS_SFCB_VALUE_ID(k),
+			   val_len);
 	if (rc) {
 		return rc;
 	}
-	(void)sfcb_write_loc(&wr_loc, name, nm_len);
-	(void)sfcb_write_loc(&wr_loc, "=", 1);
 	(void)sfcb_write_loc(&wr_loc, value, val_len);
 	rc = sfcb_close_loc(&wr_loc);
+	if (rc) {
+		return rc;
+	}
+#endif
+
+	if (!val_len) {
+		return 0;
+	}
+
+	/* The name record of a deleted name is not copied by compress, the
+	 * value is written first so a compress started by the value write
+	 * sees the name in use. A name record that was not copied (it is
+	 * gone or in the compression sector, which is erased at the next
+	 * sector) is written again.
+	 */
+	rc = settings_sfcb_dict_check(cf);
+	if (rc) {
+		return rc;
+	}
+
+	rc = sfcb_compress_sector(cf->cf_sfcb, &compress_sector);
+	if (rc) {
+		return rc;
+	}
+
+	if ((!cf->dict[k].used) || (cf->dict[k].sector == compress_sector)) {
+		rc = settings_sfcb_dict_write_name(cf, k, name, nm_len);
+	}
 	return rc;
 }
 
-int settings_sfcb_compress(sfcb_fs *fs)
+/* Does the record at loc use the id of arg */
+static bool settings_sfcb_dict_match_id(sfcb_loc *loc, void *arg)
+{
+	return (sfcb_get_ate(loc)->id == *(u16_t *)arg);
+}
+
+/* Finds the newest value of name, see the settings_sfcb_find() without name
+ * dictionary.
+ */
+static int settings_sfcb_find(struct settings_sfcb *cf, const char *name,
+			      sfcb_loc *loc, size_t *val_len)
+{
+	int rc, k;
+	u16_t id;
+
+	rc = settings_sfcb_dict_check(cf);
+	if (rc) {
+		return rc;
+	}
+
+	k = settings_sfcb_dict_find(cf, name, strlen(name));
+	if (k < 0) {
+		return k;
+	}
+
+	id = SETTINGS_SFCB_VALUE_ID(k);
+	rc = sfcb_find_loc(cf->cf_sfcb, loc, settings_sfcb_dict_match_id, &id);
+	if (rc) {
+		return rc;
+	}
+
+	*val_len = sfcb_get_ate(loc)->len;
+	return 0;
+}
+
+#define SETTINGS_SFCB_DICT_MAP_SIZE \
+	DIV_ROUND_UP(CONFIG_SETTINGS_SFCB_NAME_MAX, 8)
+
+/*
+ * State of the names for compress, found in one walk: the newest value is in
+ * use (not a delete) or a sector that is older than the compression sector
+ * holds a value.
+ */
+struct settings_sfcb_dict_state {
+	u8_t in_use[SETTINGS_SFCB_DICT_MAP_SIZE];
+	u8_t held_before[SETTINGS_SFCB_DICT_MAP_SIZE];
+};
+
+/*
+ * Index in the compression sector of the newest value and name record of each
+ * name, SETTINGS_SFCB_DICT_LAST_NONE when the newest record is in a later
+ * sector. The table is filled by the same walk as the state, compress then
+ * copies a record when it is the newest without a walk of the later records.
+ * The table is used by one compress at a time.
+ */
+#define SETTINGS_SFCB_DICT_LAST_NONE UINT16_MAX
+
+struct settings_sfcb_dict_last {
+	u16_t value;
+	u16_t name;
+};
+
+static struct settings_sfcb_dict_last
+	settings_sfcb_dict_last_tbl[CONFIG_SETTINGS_SFCB_NAME_MAX];
+static K_MUTEX_DEFINE(settings_sfcb_dict_last_lock);
+
+static inline bool settings_sfcb_dict_bit(const u8_t *map, u16_t k)
+{
+	return ((map[k >> 3] & (1U << (k & 7))) != 0U);
+}
+
+static inline void settings_sfcb_dict_bit_set(u8_t *map, u16_t k, bool val)
+{
+	if (val) {
+		map[k >> 3] |= (1U << (k & 7));
+	} else {
+		map[k >> 3] &= ~(1U << (k & 7));
+	}
+}
+
+/* Fill the state and the last table, the table lock is held by the caller */
+static int settings_sfcb_dict_state_get(sfcb_fs *fs, u16_t compress_sector,
+					struct settings_sfcb_dict_state *state)
 {
 	int rc;
-	u16_t compress_sector;
+	sfcb_loc loc;
+	sfcb_ate *ate;
+	bool before = true, in_sector;
+	u16_t k, idx = 0U, *last;
+
+	memset(state, 0, sizeof(*state));
+	memset(settings_sfcb_dict_last_tbl, 0xff,
+	       sizeof(settings_sfcb_dict_last_tbl));
+
+	rc = sfcb_start_loc(fs, &loc);
+	if (rc) {
+		return rc;
+	}
+
+	while (!sfcb_next_loc(&loc)) {
+		in_sector = (loc.sector == compress_sector);
+		if (in_sector) {
+			before = false;
+		}
+
+		ate = sfcb_get_ate(&loc);
+		if (settings_sfcb_is_value(ate->id)) {
+			k = ate->id - SETTINGS_SFCB_VALUE_ID(0);
+			settings_sfcb_dict_bit_set(state->in_use, k,
+						   (ate->len != 0));
+			if ((before) && (ate->len)) {
+				settings_sfcb_dict_bit_set(state->held_before,
+							   k, true);
+			}
+			last = &settings_sfcb_dict_last_tbl[k].value;
+		} else if (settings_sfcb_is_name(ate->id)) {
+			k = ate->id - SETTINGS_SFCB_NAME_ID(0);
+			last = &settings_sfcb_dict_last_tbl[k].name;
+		} else {
+			last = NULL;
+		}
+
+		if ((last) && (in_sector)) {
+			*last = idx;
+		} else if (last) {
+			*last = SETTINGS_SFCB_DICT_LAST_NONE;
+		}
+
+		if (in_sector) {
+			idx++;
+		}
+	}
+
+	return 0;
+}
+
+/*
+ * Compress keeps the newest value of each name that is not deleted and the
+ * newest name record of each name that is in use. The newest delete of a name
+ * is kept while an older sector holds a value of the name. The file system is
+ * walked once to find the newest records, the compression sector a second
+ * time to copy them.
+ */
+static int settings_sfcb_dict_compress(sfcb_fs *fs)
+{
+	int rc;
+	u16_t compress_sector, k, idx = 0U;
 	sfcb_loc loc_compress;
 	sfcb_ate *ate_compress;
-	char name[SETTINGS_MAX_NAME_LEN + SETTINGS_EXTRA_LEN + 1];
-	int name_len, val_len;
+	struct settings_sfcb_dict_state state;
+	bool keep;
 
 	rc = sfcb_compress_sector(fs, &compress_sector);
 	if (rc) {
 		return rc;
 	}
 
-	rc = sfcb_start_loc(fs, &loc_compress);
+	rc = sfcb_compress_start_loc(fs, &loc_compress);
 	if (rc) {
 		return rc;
 	}
 
-	while (sfcb_next_loc(&loc_compress)) {
+	k_mutex_lock(&settings_sfcb_dict_last_lock, K_FOREVER);
+	rc = settings_sfcb_dict_state_get(fs, compress_sector, &state);
+	if (rc) {
+		goto END;
+	}
+
+	while (!sfcb_next_loc(&loc_compress)) {
 
 		if (loc_compress.sector != compress_sector) {
 			break;
 		}
 
 		ate_compress = sfcb_get_ate(&loc_compress);
-		if (ate_compress->id != SETTINGS_SFCB_ID) {
-			continue;
-		}
-
-		name_len = settings_sfcb_read_name(&loc_compress, name,
-			sizeof(name));
-		if (name_len < 0) {
-			continue;
-		}
-
-		val_len = ate_compress->len - name_len - 1;
-		if (!val_len) {
-			continue;
+		if (settings_sfcb_is_value(ate_compress->id)) {
+			k = ate_compress->id - SETTINGS_SFCB_VALUE_ID(0);
+			keep = (settings_sfcb_dict_last_tbl[k].value == idx) &&
+			       ((ate_compress->len) ||
+				(settings_sfcb_dict_bit(state.held_before, k)));
+		} else if (settings_sfcb_is_name(ate_compress->id)) {
+			k = ate_compress->id - SETTINGS_SFCB_NAME_ID(0);
+			keep = (settings_sfcb_dict_last_tbl[k].name == idx) &&
+			       (settings_sfcb_dict_bit(state.in_use, k));
+		} else {
+			keep = false;
 		}
 
-		if (settings_sfcb_check_duplicate(&loc_compress, name)) {
+		idx++;
+		if (!keep) {
 			continue;
 		}
 
 		rc = sfcb_copy_loc(&loc_compress);
 		if (rc) {
-			return rc;
+			break;
 		}
 	}
 
-	return 0;
+END:
+	k_mutex_unlock(&settings_sfcb_dict_last_lock);
+	return rc;
+}
+#endif /* defined(CONFIG_SETTINGS_SFCB_NAME_DICT) */
+
+int settings_sfcb_load_direct(struct settings_sfcb *cf, const char *name,
+			      settings_load_direct_cb cb, void *param)
+{
+	struct settings_sfcb_read_fn_arg read_fn_arg;
+	size_t val_len;
+	int rc;
+
+	if ((!name) || (!cb)) {
+		return -EINVAL;
+	}
+
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+	cf = settings_sfcb_route_find(cf, name);
+#endif
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+	/* pending values are written first, as for a load */
+	k_mutex_lock(&cf->cache_lock, K_FOREVER);
+	rc = settings_sfcb_cache_flush(cf);
+	if (!rc) {
+		rc = settings_sfcb_find(cf, name, &read_fn_arg.loc, &val_len);
+	}
+	k_mutex_unlock(&cf->cache_lock);
+#else
+	rc = settings_sfcb_find(cf, name, &read_fn_arg.loc, &val_len);
+#endif
+	if (rc) {
+		return rc;
+	}
+
+	if (!val_len) {
+		/* deleted */
+		return -ENOENT;
+	}
+
+	return cb(NULL, val_len, settings_sfcb_read_fn, &read_fn_arg, param);
 }
 
 /* Initialize the sfcb backend. */
@@ -257,6 +1782,32 @@ int settings_sfcb_backend_init(struct settings_sfcb *cf)
 {
 	int rc;
 
+#if (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0)
+	cf->lookup_cnt = 0U;
+	memset(cf->lookup, 0, sizeof(cf->lookup));
+#endif
+
+#if defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+	/* the dictionary is read from flash again after a (re)mount */
+	cf->dict_valid = false;
+#endif
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+	k_mutex_init(&cf->cache_lock);
+	k_delayed_work_init(&cf->cache_work, settings_sfcb_cache_work);
+#endif
+
+#if IS_ENABLED(CONFIG_SFCB_GREEDY) && !defined(CONFIG_SETTINGS_SFCB_NAME_DICT)
+	/* Only the newest record of an id counts as live data. Without the
+	 * name dictionary names share an id and the live data of the other
+	 * names is not seen by the compression sector selection.
+	 */
+	if (cf->cf_sfcb->greedy) {
+		LOG_WRN("Greedy compress requires the name dictionary");
+		cf->cf_sfcb->greedy = false;
+	}
+#endif
+
 	rc = sfcb_mount(cf->cf_sfcb);
 	if (rc) {
 		return rc;
@@ -281,6 +1832,25 @@ struct settings_sfcb setting_store = {
     .cf_sfcb = &settings_sfcb,
 };
 
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+const sfcb_fs_cfg settings_sfcb_route_cfg = {
+	.offset = DT_FLASH_AREA_SETTINGS_ROUTE_OFFSET,
+	.size = DT_FLASH_AREA_SETTINGS_ROUTE_SIZE,
+	.dev_name = DT_FLASH_AREA_SETTINGS_ROUTE_DEV,
+};
+
+sfcb_fs settings_sfcb_route_fs = {
+	.cfg = &settings_sfcb_route_cfg,
+#if IS_ENABLED(CONFIG_SETTINGS_SFCB_ROUTE_GREEDY)
+	.greedy = true,
+#endif
+};
+
+struct settings_sfcb setting_route_store = {
+	.cf_sfcb = &settings_sfcb_route_fs,
+};
+#endif
+
 int settings_backend_init(void)
 {
 	int rc;
@@ -293,6 +1863,15 @@ int settings_backend_init(void)
     	}
     	rc = settings_sfcb_src(&setting_store);
     	rc = settings_sfcb_dst(&setting_store);
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+	rc = settings_sfcb_backend_init(&setting_route_store);
+	if (rc) {
+		sfcb_format(&settings_sfcb_route_fs);
+		settings_sfcb_backend_init(&setting_route_store);
+	}
+	rc = settings_sfcb_route(&setting_store, &setting_route_store,
+				 CONFIG_SETTINGS_SFCB_ROUTE_SUBTREE);
+#endif
 	return rc;
 }
 #endif /* defined(CONFIG_SETTINGS_SFCB_DEFAULT) */
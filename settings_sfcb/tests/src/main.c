@@ -0,0 +1,766 @@
+/*
+ * Copyright (c) 2019 Laczen
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <settings_sfcb.h>
+#include <ztest.h>
+#include <string.h>
+
+/* The test settings are "sfcb_test/0" ... "sfcb_test/7", u32_t values */
+#define TEST_KEYS 8
+
+const sfcb_fs_cfg cfg = {
+	.offset = DT_FLASH_AREA_STORAGE_OFFSET,
+	.size = DT_FLASH_AREA_STORAGE_SIZE,
+	.dev_name = DT_FLASH_AREA_STORAGE_DEV,
+};
+
+sfcb_fs sfcb = {
+	.cfg = &cfg,
+};
+
+struct settings_sfcb store = {
+	.cf_sfcb = &sfcb,
+};
+
+static u32_t val[TEST_KEYS];
+static bool val_set[TEST_KEYS];
+
+static int test_set_val(const char *name, settings_read_cb read_cb,
+			void *cb_arg, u32_t *v, bool *v_set)
+{
+	int k = name[0] - '0';
+
+	if ((k < 0) || (k >= TEST_KEYS) || (name[1] != '\0')) {
+		return -ENOENT;
+	}
+
+	if (read_cb(cb_arg, &v[k], sizeof(v[k])) != sizeof(v[k])) {
+		return -EINVAL;
+	}
+
+	v_set[k] = true;
+	return 0;
+}
+
+static int test_set(const char *name, size_t len, settings_read_cb read_cb,
+		    void *cb_arg)
+{
+	return test_set_val(name, read_cb, cb_arg, val, val_set);
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(sfcb_test, "sfcb_test", NULL, test_set, NULL,
+			       NULL);
+
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+/* The settings "sfcb_route/0" ... "sfcb_route/7" are routed to route_store */
+const sfcb_fs_cfg route_cfg = {
+	.offset = DT_FLASH_AREA_SETTINGS_ROUTE_OFFSET,
+	.size = DT_FLASH_AREA_SETTINGS_ROUTE_SIZE,
+	.dev_name = DT_FLASH_AREA_SETTINGS_ROUTE_DEV,
+};
+
+sfcb_fs route_sfcb = {
+	.cfg = &route_cfg,
+};
+
+struct settings_sfcb route_store = {
+	.cf_sfcb = &route_sfcb,
+};
+
+static u32_t route_val[TEST_KEYS];
+static bool route_val_set[TEST_KEYS];
+
+static int test_route_set(const char *name, size_t len,
+			  settings_read_cb read_cb, void *cb_arg)
+{
+	return test_set_val(name, read_cb, cb_arg, route_val, route_val_set);
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(sfcb_route, "sfcb_route", NULL, test_route_set,
+			       NULL, NULL);
+#endif /* defined(CONFIG_SETTINGS_SFCB_ROUTE) */
+
+/* Called by settings_subsys_init(), the storage is formatted first */
+int settings_backend_init(void)
+{
+	int rc;
+
+	rc = sfcb_format(&sfcb);
+	if (rc) {
+		return rc;
+	}
+
+	rc = settings_sfcb_backend_init(&store);
+	if (rc) {
+		return rc;
+	}
+
+	rc = settings_sfcb_src(&store);
+	if (rc) {
+		return rc;
+	}
+
+	rc = settings_sfcb_dst(&store);
+	if (rc) {
+		return rc;
+	}
+
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+	rc = sfcb_format(&route_sfcb);
+	if (rc) {
+		return rc;
+	}
+
+	rc = settings_sfcb_backend_init(&route_store);
+	if (rc) {
+		return rc;
+	}
+
+	rc = settings_sfcb_route(&store, &route_store, "sfcb_route");
+#endif
+	return rc;
+}
+
+static int test_save(int k, u32_t value)
+{
+	char name[16];
+
+	snprintk(name, sizeof(name), "sfcb_test/%d", k);
+	return settings_save_one(name, &value, sizeof(value));
+}
+
+static int test_delete(int k)
+{
+	char name[16];
+
+	snprintk(name, sizeof(name), "sfcb_test/%d", k);
+	return settings_delete(name);
+}
+
+static void test_load(void)
+{
+	int rc;
+
+	memset(val_set, 0, sizeof(val_set));
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+	memset(route_val_set, 0, sizeof(route_val_set));
+#endif
+	rc = settings_load();
+	zassert_true(rc == 0, "Load failed [%d]", rc);
+}
+
+static int test_direct_cb(const char *key, size_t len, settings_read_cb read_cb,
+			  void *cb_arg, void *param)
+{
+	if (len != sizeof(u32_t)) {
+		return -EINVAL;
+	}
+
+	return (read_cb(cb_arg, param, len) == len) ? 0 : -EIO;
+}
+
+static int test_load_direct(int k, u32_t *value)
+{
+	char name[16];
+
+	snprintk(name, sizeof(name), "sfcb_test/%d", k);
+	return settings_sfcb_load_direct(&store, name, test_direct_cb, value);
+}
+
+/* Mount the storage again, as after a reboot */
+static void test_remount(void)
+{
+	int rc;
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+	/* cached values are written before a shutdown */
+	rc = settings_sfcb_flush(&store);
+	zassert_true(rc == 0, "Flush failed [%d]", rc);
+#endif
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	rc = settings_sfcb_backend_init(&store);
+	zassert_true(rc == 0, "Remount failed [%d]", rc);
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+	rc = sfcb_unmount(&route_sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	rc = settings_sfcb_backend_init(&route_store);
+	zassert_true(rc == 0, "Remount failed [%d]", rc);
+#endif
+}
+
+/* Changes when anything is written to flash */
+static inline u32_t test_wr_pos(sfcb_fs *fs)
+{
+	return ((u32_t)fs->wr_sector_id << 16) | fs->wr_ate_offset;
+}
+
+void test_settings_sfcb_init(void)
+{
+	int rc;
+
+	rc = settings_subsys_init();
+	zassert_true(rc == 0, "Settings init failed [%d]", rc);
+	test_load();
+	for (int k = 0; k < TEST_KEYS; k++) {
+		zassert_false(val_set[k], "Value loaded from empty storage");
+	}
+}
+
+void test_settings_sfcb_save_load(void)
+{
+	u32_t value;
+	int rc;
+
+	zassert_true(test_save(0, 1) == 0, "Save failed");
+	zassert_true(test_save(1, 2) == 0, "Save failed");
+	test_load();
+	zassert_true(val_set[0] && (val[0] == 1), "Wrong value loaded");
+	zassert_true(val_set[1] && (val[1] == 2), "Wrong value loaded");
+	zassert_false(val_set[2], "Value loaded that was not saved");
+
+	/* only the newest value is loaded */
+	zassert_true(test_save(0, 3) == 0, "Save failed");
+	test_load();
+	zassert_true(val_set[0] && (val[0] == 3), "Wrong value loaded");
+	zassert_true(val_set[1] && (val[1] == 2), "Wrong value loaded");
+
+	rc = test_load_direct(0, &value);
+	zassert_true((rc == 0) && (value == 3), "Wrong direct load");
+	rc = test_load_direct(2, &value);
+	zassert_true(rc == -ENOENT, "Direct load of unsaved value [%d]", rc);
+}
+
+void test_settings_sfcb_delete(void)
+{
+	u32_t value;
+	int rc;
+
+	zassert_true(test_delete(1) == 0, "Delete failed");
+	test_load();
+	zassert_true(val_set[0] && (val[0] == 3), "Wrong value loaded");
+	zassert_false(val_set[1], "Deleted value loaded");
+	rc = test_load_direct(1, &value);
+	zassert_true(rc == -ENOENT, "Direct load of deleted value [%d]", rc);
+
+	/* a deleted value can be saved again */
+	zassert_true(test_save(1, 4) == 0, "Save failed");
+	test_load();
+	zassert_true(val_set[1] && (val[1] == 4), "Wrong value loaded");
+	rc = test_load_direct(1, &value);
+	zassert_true((rc == 0) && (value == 4), "Wrong direct load");
+
+	zassert_true(test_delete(1) == 0, "Delete failed");
+	test_load();
+	zassert_false(val_set[1], "Deleted value loaded");
+}
+
+void test_settings_sfcb_remount(void)
+{
+	u32_t value;
+	u16_t start;
+	int rc, i;
+
+	test_remount();
+	test_load();
+	zassert_true(val_set[0] && (val[0] == 3), "Wrong value after remount");
+	zassert_false(val_set[1], "Deleted value loaded after remount");
+
+	/* fill the storage twice, so all sectors are compressed */
+	start = sfcb.wr_sector_id;
+	for (i = 0; (u16_t)(sfcb.wr_sector_id - start) < 2 * sfcb.sector_cnt;
+	     i++) {
+		if ((i % TEST_KEYS) == 1) {
+			continue;
+		}
+
+		rc = test_save(i % TEST_KEYS, i);
+		zassert_true(rc == 0, "Save failed [%d]", rc);
+	}
+
+	zassert_true(test_delete(2) == 0, "Delete failed");
+	test_remount();
+	test_load();
+	for (int k = 0; k < TEST_KEYS; k++) {
+		if ((k == 1) || (k == 2)) {
+			zassert_false(val_set[k], "Deleted value loaded");
+			rc = test_load_direct(k, &value);
+			zassert_true(rc == -ENOENT,
+				     "Direct load of deleted value");
+			continue;
+		}
+
+		/* the newest value of key k was saved at the last i with
+		 * i % TEST_KEYS == k
+		 */
+		value = i - 1 - ((i - 1 - k) % TEST_KEYS);
+		zassert_true(val_set[k] && (val[k] == value),
+			     "Wrong value after remount");
+		rc = test_load_direct(k, &value);
+		zassert_true((rc == 0) && (value == val[k]),
+			     "Wrong direct load after remount");
+	}
+}
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+BUILD_ASSERT_MSG(CONFIG_SETTINGS_SFCB_CACHE_SIZE < TEST_KEYS,
+		 "Cache overflow test requires more test keys");
+
+void test_settings_sfcb_cache_commit(void)
+{
+	u32_t pos;
+	int rc;
+
+	pos = test_wr_pos(&sfcb);
+	zassert_true(test_save(3, 10) == 0, "Save failed");
+	zassert_true(test_save(3, 11) == 0, "Save failed");
+	zassert_true(test_save(4, 12) == 0, "Save failed");
+	zassert_true(test_wr_pos(&sfcb) == pos, "Cached save written to flash");
+
+	rc = settings_commit();
+	zassert_true(rc == 0, "Commit failed [%d]", rc);
+	zassert_false(test_wr_pos(&sfcb) == pos,
+		      "Commit did not flush the cache");
+
+	/* the cache is clean, a second commit writes nothing */
+	pos = test_wr_pos(&sfcb);
+	rc = settings_commit();
+	zassert_true(rc == 0, "Commit failed [%d]", rc);
+	zassert_true(test_wr_pos(&sfcb) == pos, "Clean cache written to flash");
+
+	test_remount();
+	test_load();
+	zassert_true(val_set[3] && (val[3] == 11), "Wrong value after commit");
+	zassert_true(val_set[4] && (val[4] == 12), "Wrong value after commit");
+}
+
+void test_settings_sfcb_cache_delete(void)
+{
+	u32_t pos, value;
+	int rc;
+
+	/* delete of a value in flash */
+	pos = test_wr_pos(&sfcb);
+	zassert_true(test_delete(3) == 0, "Delete failed");
+	zassert_true(test_wr_pos(&sfcb) == pos,
+		     "Cached delete written to flash");
+	rc = test_load_direct(3, &value);
+	zassert_true(rc == -ENOENT, "Direct load of deleted value [%d]", rc);
+	test_load();
+	zassert_false(val_set[3], "Deleted value loaded");
+
+	/* save and delete that both stay in the cache */
+	pos = test_wr_pos(&sfcb);
+	zassert_true(test_save(5, 13) == 0, "Save failed");
+	zassert_true(test_delete(5) == 0, "Delete failed");
+	zassert_true(test_wr_pos(&sfcb) == pos,
+		     "Cached delete written to flash");
+	test_load();
+	zassert_false(val_set[5], "Deleted value loaded");
+
+	test_remount();
+	test_load();
+	zassert_false(val_set[3], "Deleted value loaded after remount");
+	zassert_false(val_set[5], "Deleted value loaded after remount");
+	zassert_true(val_set[4] && (val[4] == 12), "Wrong value after remount");
+}
+
+void test_settings_sfcb_cache_overflow(void)
+{
+	u32_t pos, pos_full;
+	int rc, k;
+
+	rc = settings_commit();
+	zassert_true(rc == 0, "Commit failed [%d]", rc);
+
+	pos = test_wr_pos(&sfcb);
+	for (k = 0; k < CONFIG_SETTINGS_SFCB_CACHE_SIZE; k++) {
+		zassert_true(test_save(k, 100 + k) == 0, "Save failed");
+	}
+	zassert_true(test_wr_pos(&sfcb) == pos, "Cached save written to flash");
+
+	/* a save of another name when the cache is full flushes the cache,
+	 * the new value is kept in the cache
+	 */
+	zassert_true(test_save(k, 100 + k) == 0, "Save failed");
+	pos_full = test_wr_pos(&sfcb);
+	zassert_false(pos_full == pos, "Full cache was not flushed");
+
+	/* a save of a cached name does not flush */
+	zassert_true(test_save(k, 200 + k) == 0, "Save failed");
+	zassert_true(test_wr_pos(&sfcb) == pos_full,
+		     "Cached save written to flash");
+
+	test_load();
+	for (k = 0; k < CONFIG_SETTINGS_SFCB_CACHE_SIZE; k++) {
+		zassert_true(val_set[k] && (val[k] == 100 + k),
+			     "Wrong value after overflow");
+	}
+	zassert_true(val_set[k] && (val[k] == 200 + k),
+		     "Wrong value after overflow");
+}
+#else
+void test_settings_sfcb_cache_commit(void)
+{
+	ztest_test_skip();
+}
+
+void test_settings_sfcb_cache_delete(void)
+{
+	ztest_test_skip();
+}
+
+void test_settings_sfcb_cache_overflow(void)
+{
+	ztest_test_skip();
+}
+#endif /* defined(CONFIG_SETTINGS_SFCB_CACHE) */
+
+#if defined(CONFIG_SETTINGS_SFCB_ROUTE)
+static int test_route_save(int k, u32_t value)
+{
+	char name[16];
+
+	snprintk(name, sizeof(name), "sfcb_route/%d", k);
+	return settings_save_one(name, &value, sizeof(value));
+}
+
+void test_settings_sfcb_route(void)
+{
+	u32_t pos, route_pos, value;
+	int rc;
+
+	pos = test_wr_pos(&sfcb);
+	route_pos = test_wr_pos(&route_sfcb);
+	zassert_true(test_route_save(0, 7) == 0, "Save failed");
+	zassert_true(test_route_save(1, 8) == 0, "Save failed");
+	rc = settings_commit();
+	zassert_true(rc == 0, "Commit failed [%d]", rc);
+	zassert_true(test_wr_pos(&sfcb) == pos, "Routed save in destination");
+	zassert_false(test_wr_pos(&route_sfcb) == route_pos,
+		      "Routed save not in routed backend");
+
+	test_load();
+	zassert_true(route_val_set[0] && (route_val[0] == 7),
+		     "Wrong routed value loaded");
+	zassert_true(route_val_set[1] && (route_val[1] == 8),
+		     "Wrong routed value loaded");
+
+	/* a direct load from the destination finds the routed backend */
+	rc = settings_sfcb_load_direct(&store, "sfcb_route/0", test_direct_cb,
+				       &value);
+	zassert_true((rc == 0) && (value == 7), "Wrong direct load");
+
+	/* a delete is routed as well */
+	route_pos = test_wr_pos(&route_sfcb);
+	zassert_true(settings_delete("sfcb_route/1") == 0, "Delete failed");
+	rc = settings_commit();
+	zassert_true(rc == 0, "Commit failed [%d]", rc);
+	zassert_true(test_wr_pos(&sfcb) == pos, "Routed delete in destination");
+	zassert_false(test_wr_pos(&route_sfcb) == route_pos,
+		      "Routed delete not in routed backend");
+
+	test_remount();
+	test_load();
+	zassert_true(route_val_set[0] && (route_val[0] == 7),
+		     "Wrong routed value after remount");
+	zassert_false(route_val_set[1], "Deleted routed value loaded");
+}
+
+void test_settings_sfcb_route_default(void)
+{
+	u32_t pos, route_pos;
+	int rc;
+
+	/* names outside the routed subtree stay in the destination, also
+	 * when they start with the subtree name
+	 */
+	pos = test_wr_pos(&sfcb);
+	route_pos = test_wr_pos(&route_sfcb);
+	zassert_true(test_save(6, 9) == 0, "Save failed");
+	rc = settings_save_one("sfcb_routex/0", &pos, sizeof(pos));
+	zassert_true(rc == 0, "Save failed [%d]", rc);
+	rc = settings_commit();
+	zassert_true(rc == 0, "Commit failed [%d]", rc);
+	zassert_false(test_wr_pos(&sfcb) == pos, "Save not in destination");
+	zassert_true(test_wr_pos(&route_sfcb) == route_pos,
+		     "Save in routed backend");
+
+	test_load();
+	zassert_true(val_set[6] && (val[6] == 9), "Wrong value loaded");
+	zassert_true(route_val_set[0] && (route_val[0] == 7),
+		     "Wrong routed value loaded");
+
+	zassert_true(settings_delete("sfcb_routex/0") == 0, "Delete failed");
+	zassert_true(test_wr_pos(&route_sfcb) == route_pos,
+		     "Delete in routed backend");
+
+	/* a subtree is routed once, to a single top-level subtree */
+	rc = settings_sfcb_route(&store, &route_store, "sfcb_route");
+	zassert_true(rc == -EINVAL, "Backend routed twice [%d]", rc);
+	rc = settings_sfcb_route(&store, &store, "sfcb_other");
+	zassert_true(rc == -EINVAL, "Destination routed to itself [%d]", rc);
+}
+#else
+void test_settings_sfcb_route(void)
+{
+	ztest_test_skip();
+}
+
+void test_settings_sfcb_route_default(void)
+{
+	ztest_test_skip();
+}
+#endif /* defined(CONFIG_SETTINGS_SFCB_ROUTE) */
+
+#if (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0) && \
+	IS_ENABLED(CONFIG_SFCB_STATS)
+BUILD_ASSERT_MSG(CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE + 2 <= TEST_KEYS,
+		 "Lookup eviction test requires more test keys");
+
+/* Direct load of key k, returns the flash reads */
+static u32_t test_lookup(int k, u32_t *value)
+{
+	u32_t rd = sfcb.stats.flash_rd_cnt;
+	int rc;
+
+	rc = test_load_direct(k, value);
+	zassert_true(rc == 0, "Direct load failed [%d]", rc);
+	return sfcb.stats.flash_rd_cnt - rd;
+}
+
+/* Save key 0 and move it two sectors back by saves of the other keys */
+static void test_lookup_setup(u32_t value)
+{
+	u16_t start;
+	int i = 0;
+
+	zassert_true(test_save(0, value) == 0, "Save failed");
+	start = sfcb.wr_sector_id;
+	while ((u16_t)(sfcb.wr_sector_id - start) < 2) {
+		zassert_true(test_save(1 + (i % (TEST_KEYS - 1)), i) == 0,
+			     "Save failed");
+		i++;
+	}
+}
+
+void test_settings_sfcb_lookup_hit(void)
+{
+	u32_t miss, hit, value;
+
+	test_lookup_setup(20);
+	miss = test_lookup(0, &value);
+	zassert_true(value == 20, "Wrong direct load");
+	hit = test_lookup(0, &value);
+	zassert_true(value == 20, "Wrong direct load from lookup cache");
+	TC_PRINT("lookup reads: %u for a miss, %u for a hit\n", miss, hit);
+	zassert_true(hit < miss, "Lookup cache not used");
+}
+
+void test_settings_sfcb_lookup_evict(void)
+{
+	u32_t hit, rd, value;
+	int k;
+
+	test_lookup_setup(21);
+	(void)test_lookup(0, &value);
+	hit = test_lookup(0, &value);
+
+	/* fill the cache with other names, key 0 is used in between and
+	 * is kept when the next name replaces the least recently used entry
+	 */
+	for (k = 2; k < CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE + 1; k++) {
+		(void)test_lookup(k, &value);
+	}
+
+	rd = test_lookup(0, &value);
+	zassert_true((value == 21) && (rd == hit), "Lookup cache not used");
+	(void)test_lookup(k, &value);
+	rd = test_lookup(0, &value);
+	zassert_true((value == 21) && (rd == hit),
+		     "Recently used entry replaced");
+
+	/* key 0 is replaced when it is the least recently used entry */
+	for (k = 2; k < CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE + 2; k++) {
+		(void)test_lookup(k, &value);
+	}
+
+	rd = test_lookup(0, &value);
+	zassert_true(value == 21, "Wrong direct load");
+	zassert_true(rd > hit, "Least recently used entry not replaced");
+}
+
+void test_settings_sfcb_lookup_invalidate(void)
+{
+	u32_t value;
+	int rc;
+
+	test_lookup_setup(22);
+	(void)test_lookup(0, &value);
+	(void)test_lookup(0, &value);
+	zassert_true(value == 22, "Wrong direct load from lookup cache");
+
+	/* the cached record is no longer the newest after a save */
+	zassert_true(test_save(0, 23) == 0, "Save failed");
+	(void)test_lookup(0, &value);
+	zassert_true(value == 23, "Stale lookup cache entry used");
+	(void)test_lookup(0, &value);
+	zassert_true(value == 23, "Wrong direct load from lookup cache");
+
+	zassert_true(test_delete(0) == 0, "Delete failed");
+	rc = test_load_direct(0, &value);
+	zassert_true(rc == -ENOENT, "Stale lookup cache entry used [%d]", rc);
+	test_load();
+	zassert_false(val_set[0], "Deleted value loaded");
+}
+#else
+void test_settings_sfcb_lookup_hit(void)
+{
+	ztest_test_skip();
+}
+
+void test_settings_sfcb_lookup_evict(void)
+{
+	ztest_test_skip();
+}
+
+void test_settings_sfcb_lookup_invalidate(void)
+{
+	ztest_test_skip();
+}
+#endif /* (CONFIG_SETTINGS_SFCB_LOOKUP_CACHE_SIZE > 0) && ... */
+
+#if IS_ENABLED(CONFIG_SFCB_STATS) && \
+	(defined(CONFIG_SETTINGS_SFCB_NAME_DICT) || \
+	 (CONFIG_SETTINGS_SFCB_LOAD_TABLE_SIZE > 0))
+/* Without the dictionary or the load table compress walks the later records
+ * for each record. The storage partition on nrf51_pca10028 has 6 sectors.
+ */
+const sfcb_fs_cfg cfg3sector = {
+	.offset = DT_FLASH_AREA_STORAGE_OFFSET,
+	.size = 3 * DT_FLASH_ERASE_BLOCK_SIZE,
+	.dev_name = DT_FLASH_AREA_STORAGE_DEV,
+};
+
+const sfcb_fs_cfg cfg6sector = {
+	.offset = DT_FLASH_AREA_STORAGE_OFFSET,
+	.size = 6 * DT_FLASH_ERASE_BLOCK_SIZE,
+	.dev_name = DT_FLASH_AREA_STORAGE_DEV,
+};
+
+static int (*test_compress_fn)(sfcb_fs *fs);
+static u32_t test_compress_rd;
+
+/* Keeps the flash reads of the slowest compress */
+static int test_compress(sfcb_fs *fs)
+{
+	u32_t rd = fs->stats.flash_rd_cnt;
+	int rc;
+
+	rc = test_compress_fn(fs);
+	test_compress_rd = MAX(test_compress_rd, fs->stats.flash_rd_cnt - rd);
+	return rc;
+}
+
+/* Format the storage with configuration c and mount it */
+static void test_reformat(const sfcb_fs_cfg *c)
+{
+	int rc;
+
+#if defined(CONFIG_SETTINGS_SFCB_CACHE)
+	/* cached values are not written to the new storage */
+	rc = settings_sfcb_flush(&store);
+	zassert_true(rc == 0, "Flush failed [%d]", rc);
+#endif
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	sfcb.cfg = c;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = settings_sfcb_backend_init(&store);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+}
+
+/* Fill the storage with configuration c twice, get the flash reads of the
+ * slowest compress of the second fill and of a walk over all records.
+ */
+static void test_compress_reads(const sfcb_fs_cfg *c, u32_t *compress_rd,
+				u32_t *walk_rd)
+{
+	sfcb_loc loc;
+	u32_t rd;
+	u16_t start;
+	int rc, i = 0;
+
+	test_reformat(c);
+	test_compress_fn = sfcb.compress;
+	sfcb.compress = test_compress;
+	for (int fill = 0; fill < 2; fill++) {
+		test_compress_rd = 0U;
+		start = sfcb.wr_sector_id;
+		while ((u16_t)(sfcb.wr_sector_id - start) < sfcb.sector_cnt) {
+			rc = test_save(i % TEST_KEYS, i);
+			zassert_true(rc == 0, "Save failed [%d]", rc);
+			i++;
+		}
+	}
+
+	sfcb.compress = test_compress_fn;
+	*compress_rd = test_compress_rd;
+
+	rd = sfcb.stats.flash_rd_cnt;
+	rc = sfcb_start_loc(&sfcb, &loc);
+	zassert_true(rc == 0, "Start loc failed [%d]", rc);
+	while (!sfcb_next_loc(&loc)) {
+	}
+	*walk_rd = sfcb.stats.flash_rd_cnt - rd;
+}
+
+void test_settings_sfcb_compress_reads(void)
+{
+	u32_t rd3, rd6, walk3, walk6;
+
+	test_compress_reads(&cfg3sector, &rd3, &walk3);
+	test_compress_reads(&cfg6sector, &rd6, &walk6);
+	TC_PRINT("compress reads: %u (walk %u) for 3 sectors, "
+		 "%u (walk %u) for 6 sectors\n", rd3, walk3, rd6, walk6);
+
+	/* compress walks the file system once (and reads the names without
+	 * the dictionary) and the compression sector again, the reads grow
+	 * as the reads of a walk
+	 */
+	zassert_true(rd3 <= 4 * walk3, "Compress reads not linear");
+	zassert_true(rd6 <= 4 * walk6, "Compress reads not linear");
+	zassert_true(rd6 <= 3 * rd3, "Compress reads not linear");
+
+	test_reformat(&cfg);
+}
+#else
+void test_settings_sfcb_compress_reads(void)
+{
+	ztest_test_skip();
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_STATS) && ... */
+
+void test_main(void)
+{
+	ztest_test_suite(test_settings_sfcb,
+			 ztest_unit_test(test_settings_sfcb_init),
+			 ztest_unit_test(test_settings_sfcb_save_load),
+			 ztest_unit_test(test_settings_sfcb_delete),
+			 ztest_unit_test(test_settings_sfcb_remount),
+			 ztest_unit_test(test_settings_sfcb_cache_commit),
+			 ztest_unit_test(test_settings_sfcb_cache_delete),
+			 ztest_unit_test(test_settings_sfcb_cache_overflow),
+			 ztest_unit_test(test_settings_sfcb_route),
+			 ztest_unit_test(test_settings_sfcb_route_default),
+			 ztest_unit_test(test_settings_sfcb_lookup_hit),
+			 ztest_unit_test(test_settings_sfcb_lookup_evict),
+			 ztest_unit_test(test_settings_sfcb_lookup_invalidate),
+			 ztest_unit_test(test_settings_sfcb_compress_reads)
+			);
+
+	ztest_run_test_suite(test_settings_sfcb);
+}
@@ -0,0 +1,137 @@
+/*
+ * Copyright (c) 2019 Laczen
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <sfcb.h>
+#include <string.h>
+
+#define BENCH_ITEMS 1000
+#define BENCH_ROUNDS 10
+
+// variables used by the filesystem
+sfcb_fs sfcb;
+
+// configuration of the filesystem is provided by this struct
+const sfcb_fs_cfg cfg = {
+	.offset = DT_FLASH_AREA_STORAGE_OFFSET,
+	.size = DT_FLASH_AREA_STORAGE_SIZE,
+	.dev_name = DT_FLASH_AREA_STORAGE_DEV,
+};
+
+static u32_t bench_us(u32_t start)
+{
+	u32_t cycles = k_cycle_get_32() - start;
+
+	return (u32_t)(SYS_CLOCK_HW_CYCLES_TO_NS64(cycles) / 1000U);
+}
+
+static void bench_report(const char *name, u32_t us, u32_t rd, u32_t er)
+{
+	printk("%s: %u us, %u flash reads, %u erases\n", name, us, rd, er);
+}
+
+// time a format and report the flash reads and erases it did
+static int bench_format(const char *name)
+{
+	int rc;
+	u32_t start, rd, er;
+
+	rd = sfcb.stats.flash_rd_cnt;
+	er = sfcb.stats.flash_er_cnt;
+	start = k_cycle_get_32();
+	rc = sfcb_format(&sfcb);
+	if (rc) {
+		return rc;
+	}
+
+	bench_report(name, bench_us(start), sfcb.stats.flash_rd_cnt - rd,
+		     sfcb.stats.flash_er_cnt - er);
+	return 0;
+}
+
+// walk all ates, every ate visited has its crc8 verified
+static int bench_walk(void)
+{
+	sfcb_loc loc;
+	u32_t start, rd, cnt = 0U;
+	int i;
+
+	rd = sfcb.stats.flash_rd_cnt;
+	start = k_cycle_get_32();
+	for (i = 0; i < BENCH_ROUNDS; i++) {
+		if (sfcb_start_loc(&sfcb, &loc)) {
+			return -EIO;
+		}
+
+		while (!sfcb_next_loc(&loc)) {
+			cnt++;
+		}
+	}
+
+	printk("ate walk (%u ates): ", cnt / BENCH_ROUNDS);
+	bench_report("", bench_us(start) / BENCH_ROUNDS,
+		     (sfcb.stats.flash_rd_cnt - rd) / BENCH_ROUNDS, 0U);
+	return 0;
+}
+
+// entry point
+int main(void) {
+    int rc;
+    u32_t i, start, rd;
+    sfcb_loc loc;
+
+    sfcb.cfg = &cfg;
+
+    // format a used (or unknown) flash area
+    rc = bench_format("format used");
+    if (rc) {
+        goto END;
+    }
+
+    // format again, now all sectors except the first are blank
+    rc = bench_format("format blank");
+    if (rc) {
+        goto END;
+    }
+
+    rc = sfcb_mount(&sfcb);
+    if (rc) {
+        goto END;
+    }
+
+    for (i = 0; i < BENCH_ITEMS; i++) {
+        rc = sfcb_open_loc(&sfcb, &loc, i % 64, sizeof(i));
+        if (rc) {
+            goto END;
+        }
+        (void)sfcb_write_loc(&loc, &i, sizeof(i));
+        rc = sfcb_close_loc(&loc);
+        if (rc) {
+            goto END;
+        }
+    }
+
+    rc = bench_walk();
+    if (rc) {
+        goto END;
+    }
+
+    sfcb_unmount(&sfcb);
+
+    rd = sfcb.stats.flash_rd_cnt;
+    start = k_cycle_get_32();
+    rc = sfcb_mount(&sfcb);
+    if (rc) {
+        goto END;
+    }
+    bench_report("mount", bench_us(start), sfcb.stats.flash_rd_cnt - rd, 0U);
+    sfcb_unmount(&sfcb);
+
+    // format with data in all sectors
+    rc = bench_format("format full");
+
+END:
+    printk("benchmark %s (%d)\n", rc ? "failed" : "done", rc);
+    return 0;
+}
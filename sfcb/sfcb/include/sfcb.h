@@ -67,7 +67,7 @@ BUILD_ASSERT_MSG(SFCB_ATE_SIZE % CONFIG_SFCB_WBS == 0,
  * @param id: data id
  * @param offset: data offset within sector
  * @param len: data length
- * @param pad8: pads to fill up - unused
+ * @param pad8: ate type in pad8[0] (0xff for data), remainder unused
  * @param crc8: CRC8 check of the Allocation TAble Entry
  */
 typedef struct {
@@ -78,6 +78,13 @@ typedef struct {
 	u8_t crc8;
 } __packed sfcb_ate;
 
+/* ate type of a directory ate (pad8[0]) */
+#define SFCB_ATE_DIR 0x64
+#define SFCB_DIR_ID 0xffff
+
+/* ate type of a compress sector marker (pad8[0]), id is the sector */
+#define SFCB_ATE_VICTIM 0x76
+
 #define SFCB_SEC_START_SIZE MAX(CONFIG_SFCB_WBS, 8)
 
 BUILD_ASSERT_MSG(SFCB_SEC_START_SIZE % CONFIG_SFCB_WBS == 0,
@@ -121,6 +128,43 @@ typedef struct {
 	sfcb_fs *fs;
 } sfcb_loc;
 
+/**
+ * @brief SFCB statistics
+ *
+ * @param wr_bytes: data bytes written to closed locations
+ * @param cp_bytes: data bytes copied by sfcb_copy_loc()
+ * @param cp_cnt: items copied by sfcb_copy_loc()
+ * @param flash_rd_cnt: flash read operations
+ * @param flash_wr_cnt: flash write operations
+ * @param flash_wr_bytes: bytes written to flash
+ * @param flash_er_cnt: flash erase operations
+ * @param skip_cnt: writes skipped by sfcb_write_if_changed() or counted by
+ *		  sfcb_stats_skip()
+ */
+typedef struct {
+	u32_t wr_bytes;
+	u32_t cp_bytes;
+	u32_t cp_cnt;
+	u32_t flash_rd_cnt;
+	u32_t flash_wr_cnt;
+	u32_t flash_wr_bytes;
+	u32_t flash_er_cnt;
+	u32_t skip_cnt;
+} sfcb_stats;
+
+/**
+ * @brief SFCB live data entry, location of the newest data for an id
+ *
+ * @param id: data id
+ * @param sector: sector that holds the newest data
+ * @param size: flash space used by the newest data (data and ate)
+ */
+typedef struct {
+	u16_t id;
+	u16_t sector;
+	u16_t size;
+} sfcb_live_entry;
+
 /**
  * @brief SFCB File system structure
  *
@@ -134,6 +178,28 @@ typedef struct {
  * @param wr_lock: mutex locked during write
  * @param compress: pointer to compress routine supplied by user
  * @param cfg: file system configuration
+ * @param read_only: file system is mounted read-only
+ * @param log: file system is a circular log, the oldest sector is erased
+ *             without compress or copies, set by user
+ * @param cold_head: use a separate write head for copied data (with greedy),
+ *                   set by user
+ * @param cd_open: cold write head is open
+ * @param cd_sector: cold write sector
+ * @param cd_data_offset: cold data write offset in sector
+ * @param cd_ate_offset: cold ATE write offset in sector
+ * @param stats: file system statistics
+ * @param greedy: compress the sector with the least live data, set by user
+ * @param gr_victim: compress sector
+ * @param gr_next: next (newer) sector, the newest is followed by the oldest
+ * @param gr_prev: previous (older) sector
+ * @param gr_sec_id: sector id of each sector
+ * @param gr_live: live bytes in each sector
+ * @param gr_live_cnt: number of entries in gr_live_tbl
+ * @param gr_live_tbl: location of the newest data of each id, sorted by id
+ * @param compress_loc: pointer to incremental compress routine supplied by
+ *                      user, called for each item in the compression sector
+ * @param cp_busy: incremental compress is busy
+ * @param cp_loc: incremental compress location
  */
 struct sfcb_fs {
 	u16_t wr_sector;
@@ -146,6 +212,33 @@ struct sfcb_fs {
 	struct k_mutex mutex;
 	int (*compress)(sfcb_fs *fs);
 	const sfcb_fs_cfg *cfg;
+	bool read_only;
+	bool log;
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	bool cold_head;
+	bool cd_open;
+	u16_t cd_sector;
+	u16_t cd_data_offset;
+	u16_t cd_ate_offset;
+#endif
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+	sfcb_stats stats;
+#endif
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	bool greedy;
+	u16_t gr_victim;
+	u16_t gr_next[CONFIG_SFCB_GREEDY_MAX_SECTORS];
+	u16_t gr_prev[CONFIG_SFCB_GREEDY_MAX_SECTORS];
+	u16_t gr_sec_id[CONFIG_SFCB_GREEDY_MAX_SECTORS];
+	u16_t gr_live[CONFIG_SFCB_GREEDY_MAX_SECTORS];
+	u16_t gr_live_cnt;
+	sfcb_live_entry gr_live_tbl[CONFIG_SFCB_GREEDY_LIVE_IDS];
+#endif
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+	int (*compress_loc)(sfcb_loc *loc);
+	bool cp_busy;
+	sfcb_loc cp_loc;
+#endif
 };
 
 /**
@@ -179,6 +272,20 @@ inline sfcb_ate *sfcb_get_ate(sfcb_loc *loc)
  */
 int sfcb_mount(sfcb_fs *fs);
 
+/**
+ * @brief sfcb_mount_ro
+ *
+ * Mounts a SFCB file system in flash for reading only. Only the newest sector
+ * is located, the write position is not searched and compress is never
+ * called. Iterators end at the first blank ATE in the newest sector. Writing
+ * to a file system mounted read-only returns -EROFS.
+ *
+ * @param fs: Pointer to file system
+ * @retval 0 Success
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_mount_ro(sfcb_fs *fs);
+
 /**
  * @brief sfcb_unmount
  *
@@ -209,10 +316,37 @@ int sfcb_format(sfcb_fs *fs);
  * @param data: pointer to data
  * @param len: bytes to write
  * @retval bytes written
+ * @retval -EAGAIN the data does not fit next to the space reserved for an
+ *         incremental compress, retry the write
  * @retval -ERRNO errno code if error
  */
 ssize_t sfcb_write(sfcb_fs *fs, u16_t id, const void *data, size_t len);
 
+/**
+ * @brief sfcb_write_if_changed(sfcb_fs *fs, u16_t id, const void *data,
+ *				size_t len)
+ *
+ * Write data to sfcb filesystem when it differs from the newest data of id.
+ * The newest data is compared (length and content) before writing, when it
+ * is equal nothing is written.
+ * @param id: identifier
+ * @param data: pointer to data
+ * @param len: bytes to write
+ * @retval bytes written (or len when the data is unchanged)
+ * @retval -ERRNO errno code if error
+ */
+ssize_t sfcb_write_if_changed(sfcb_fs *fs, u16_t id, const void *data,
+			      size_t len);
+
+/**
+ * @brief sfcb_stats_skip(sfcb_fs *fs)
+ *
+ * Count a write that was skipped because the data is unchanged, for users
+ * that compare the data themselves. Does nothing without CONFIG_SFCB_STATS.
+ * @param fs: pointer to file system
+ */
+void sfcb_stats_skip(sfcb_fs *fs);
+
 /**
  * @brief sfcb_read(sfcb_fs *fs, u16_t id, void *data, size_t len)
  *
@@ -225,6 +359,27 @@ ssize_t sfcb_write(sfcb_fs *fs, u16_t id, const void *data, size_t len);
  */
 ssize_t sfcb_read(sfcb_fs *fs, u16_t id, void *data, size_t len);
 
+/**
+ * @brief sfcb_read_many(sfcb_fs *fs, const u16_t *ids, sfcb_loc *locs,
+ *			 size_t n, int (*cb)(u16_t id, sfcb_loc *loc, void *arg),
+ *			 void *arg)
+ *
+ * Read data for several ids from sfcb filesystem in a single walk. The newest
+ * location of each id is stored in locs, afterwards cb is called for each id
+ * that is found (in the order of ids). The data can be read in cb using
+ * sfcb_read_loc(). Ids that are not found have locs[i].fs set to NULL.
+ * @param fs: pointer to file system
+ * @param ids: identifiers, sorted in ascending order without duplicates
+ * @param locs: table of n locations supplied by the caller
+ * @param n: number of identifiers
+ * @param cb: callback called for each found id (can be NULL)
+ * @param arg: argument passed to cb
+ * @retval number of ids found
+ * @retval -ERRNO errno code if error (or non zero return value of cb)
+ */
+int sfcb_read_many(sfcb_fs *fs, const u16_t *ids, sfcb_loc *locs, size_t n,
+		   int (*cb)(u16_t id, sfcb_loc *loc, void *arg), void *arg);
+
 /**
  * @brief sfcb_open_loc(sfcb_fs *fs, sfcb_loc *loc)
  *
@@ -234,6 +389,8 @@ ssize_t sfcb_read(sfcb_fs *fs, u16_t id, void *data, size_t len);
  * @param id: identifier
  * @param len: required storage length
  * @retval 0 Success
+ * @retval -EAGAIN the data does not fit next to the space reserved for an
+ *         incremental compress, retry the open
  * @retval -ERRNO errno code if error
  */
 int sfcb_open_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t id, u16_t len);
@@ -272,10 +429,25 @@ ssize_t sfcb_write_loc(sfcb_loc *loc, const void *data, size_t len);
  */
 ssize_t sfcb_read_loc(sfcb_loc *loc, void *data, size_t len);
 
+/**
+ * @brief sfcb_cmp_loc(sfcb_loc *loc, const void *data, size_t len)
+ *
+ * Compare data with the data of a location from the read position, the data
+ * is read in blocks of SFCB_BLOCK_SIZE.
+ * @param loc: pointer to location
+ * @param data: pointer to data
+ * @param len: bytes to compare
+ * @retval 0 data is equal
+ * @retval 1 data differs (or the location has less than len bytes left)
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_cmp_loc(sfcb_loc *loc, const void *data, size_t len);
+
 /**
  * @brief sfcb_copy_loc(sfcb_loc *loc)
  *
- * Copies the data at loc to the current write location.
+ * Copies the data at loc to the current write location, a log (see
+ * sfcb_loc_seq()) does not copy and returns -EPERM.
  * @param loc: pointer to location
  * @retval 0 Succes
  * @retval -ERRNO errno code if error
@@ -306,6 +478,25 @@ int sfcb_next_loc(sfcb_loc *loc);
  */
 int sfcb_start_loc(sfcb_fs *fs, sfcb_loc *loc);
 
+/**
+ * @brief sfcb_find_loc(sfcb_fs *fs, sfcb_loc *loc, match, arg)
+ *
+ * Find the newest location for which match(loc, arg) returns true. The
+ * sectors are searched from the newest to the oldest and the search ends in
+ * the first sector with a match, so only the ates of the sectors that are
+ * newer than the location are read. match can read the data of the location,
+ * the read position of the location found is at the start of the data.
+ * @param fs: pointer to file system
+ * @param loc: pointer to location
+ * @param match: match routine
+ * @param arg: argument for match
+ * @retval 0 Succes
+ * @retval -ENOENT no location matches
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_find_loc(sfcb_fs *fs, sfcb_loc *loc,
+		  bool (*match)(sfcb_loc *loc, void *arg), void *arg);
+
 /**
  * @brief sfcb_compress_sector(sfcb_fs *fs, u16_t *sectors)
  *
@@ -317,6 +508,82 @@ int sfcb_start_loc(sfcb_fs *fs, sfcb_loc *loc);
  */
 int sfcb_compress_sector(sfcb_fs *fs, u16_t *sector);
 
+/**
+ * @brief sfcb_compress_start_loc(sfcb_fs *fs, sfcb_loc *loc)
+ *
+ * Get start location of the compression sector, a call to sfcb_next_loc()
+ * will return the first real loc in the compression sector (or a loc after
+ * it when the compression sector is empty). Without CONFIG_SFCB_GREEDY this
+ * is the same as sfcb_start_loc().
+ *
+ * @param fs: pointer to file system
+ * @param loc: pointer to location
+ * @retval 0 Succes
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_compress_start_loc(sfcb_fs *fs, sfcb_loc *loc);
+
+/**
+ * @brief sfcb_loc_seq(sfcb_loc *loc, u32_t *seq)
+ *
+ * Get the sequence number of a location. The sequence number is derived from
+ * the sector id (upper 16 bit) and the ate position in the sector (lower 16
+ * bit), it increases monotonically (modulo 2^32) for each written location.
+ * A location copied by compress is a new location with a new sequence number,
+ * and a copy to the cold head goes to an older sector. Set the log member of
+ * the file system to use sequence numbers for export: a log does not
+ * compress, copy or use the cold head, so each location is returned once.
+ * @param loc: pointer to location
+ * @param seq: pointer to sequence number
+ * @retval 0 Succes
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_loc_seq(sfcb_loc *loc, u32_t *seq);
+
+/**
+ * @brief sfcb_seek_seq(sfcb_fs *fs, sfcb_loc *loc, u32_t seq)
+ *
+ * Initialize a location so that a call to sfcb_next_loc() will return the
+ * first location with a sequence number equal or larger than seq. Only the
+ * sector starts are read to find the location. If seq is older than the
+ * oldest location the next location is the first location in the file system.
+ * @param fs: pointer to file system
+ * @param loc: pointer to location
+ * @param seq: sequence number
+ * @retval 0 Succes
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_seek_seq(sfcb_fs *fs, sfcb_loc *loc, u32_t seq);
+
+/**
+ * @brief sfcb_cursor_set(sfcb_fs *fs, u16_t id, sfcb_loc *loc)
+ *
+ * Store a persistent cursor with identifier id just after location loc, e.g.
+ * after exporting all locations up to and including loc. The cursor is stored
+ * as a normal item. In a log it is erased with its sector, together with the
+ * locations it covers.
+ * @param fs: pointer to file system
+ * @param id: cursor identifier
+ * @param loc: pointer to last handled location
+ * @retval 0 Succes
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_cursor_set(sfcb_fs *fs, u16_t id, sfcb_loc *loc);
+
+/**
+ * @brief sfcb_cursor_get(sfcb_fs *fs, u16_t id, sfcb_loc *loc)
+ *
+ * Initialize a location from the persistent cursor with identifier id, a call
+ * to sfcb_next_loc() will return the first location after the cursor. When
+ * no cursor is stored the location is initialized as by sfcb_start_loc().
+ * @param fs: pointer to file system
+ * @param id: cursor identifier
+ * @param loc: pointer to location
+ * @retval 0 Succes
+ * @retval -ERRNO errno code if error
+ */
+int sfcb_cursor_get(sfcb_fs *fs, u16_t id, sfcb_loc *loc);
+
 int sfcb_rewind_loc(sfcb_loc *loc);
 
 int sfcb_setpos_loc(sfcb_loc *loc, u16_t pos);
@@ -20,6 +20,28 @@ static inline u16_t sfcb_align_up(u16_t len)
 	return sfcb_align_down(len + CONFIG_SFCB_WBS - 1U);
 }
 
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+#define SFCB_STATS_ADD(fs, item, val) ((fs)->stats.item += (val))
+#else
+#define SFCB_STATS_ADD(fs, item, val)
+#endif
+
+static inline bool sfcb_has_compress(sfcb_fs *fs)
+{
+	if (fs->log) {
+		/* a log drops the oldest sector, copies would be exported
+		 * again with a new sequence number
+		 */
+		return false;
+	}
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+	if (fs->compress_loc) {
+		return true;
+	}
+#endif
+	return (fs->compress != NULL);
+}
+
 static inline void sfcb_lock(sfcb_fs *fs)
 {
 	k_mutex_lock(&fs->mutex, K_FOREVER);
@@ -41,6 +63,11 @@ static inline s16_t sfcb_scmp(u16_t a, u16_t b) {
     return (s16_t)(a - b);
 }
 
+/* Sequence comparison of two u32_t, see sfcb_scmp() */
+static inline s32_t sfcb_scmp32(u32_t a, u32_t b) {
+    return (s32_t)(a - b);
+}
+
 /*
  * Unaligned write using a cache to read from at unaligned start and to store
  * remainder at unaligned end.
@@ -95,6 +122,8 @@ static int sfcb_flash_write(sfcb_fs *fs, u16_t sec, u16_t sec_off,
 		if (rc) {
 			goto END;
 		}
+		SFCB_STATS_ADD(fs, flash_wr_cnt, 1);
+		SFCB_STATS_ADD(fs, flash_wr_bytes, CONFIG_SFCB_WBS);
 		off += CONFIG_SFCB_WBS;
 	}
 
@@ -105,6 +134,8 @@ static int sfcb_flash_write(sfcb_fs *fs, u16_t sec, u16_t sec_off,
 		if (rc) {
 			goto END;
 		}
+		SFCB_STATS_ADD(fs, flash_wr_cnt, 1);
+		SFCB_STATS_ADD(fs, flash_wr_bytes, cnt);
 		len -= cnt;
 		off += cnt;
 		data8 += cnt;
@@ -138,6 +169,7 @@ static int sfcb_flash_read(sfcb_fs *fs, u16_t sec, u16_t sec_off, void *data,
 		return -EINVAL;
 	}
 
+	SFCB_STATS_ADD(fs, flash_rd_cnt, 1);
 	return flash_read(fs->flash_device, off, data8, len);
 }
 
@@ -159,21 +191,37 @@ static int sfcb_flash_sector_erase(sfcb_fs *fs, u16_t sector)
 	if (flash_erase(fs->flash_device, offset, fs->sector_size)) {
 		return -ENXIO;
 	}
+	SFCB_STATS_ADD(fs, flash_er_cnt, 1);
 
 	(void) flash_write_protection_set(fs->flash_device, 1);
 
 	return 0;
 }
 
+/* sfcb_cmp_const compares a word at a time when data is aligned, on the
+ * first difference it falls back to bytes to return the same result as a
+ * byte compare.
+ */
 static int sfcb_cmp_const(const void *data, u8_t value, size_t len)
 {
 	const u8_t *data8 = (const u8_t *)data;
+	const u32_t *data32;
+	u32_t value32 = value * 0x01010101U;
 	int i;
 
 	if ((!data) || (!len)) {
 		return -EINVAL;
 	}
 
+	if (!((uintptr_t)data8 & (sizeof(u32_t) - 1U))) {
+		data32 = (const u32_t *)data8;
+		while ((len >= sizeof(u32_t)) && (*data32 == value32)) {
+			data32++;
+			len -= sizeof(u32_t);
+		}
+		data8 = (const u8_t *)data32;
+	}
+
 	for (i=0; i < len; i++) {
 		if (data8[i] != value) {
 			return data8[i] - value;
@@ -183,6 +231,58 @@ static int sfcb_cmp_const(const void *data, u8_t value, size_t len)
 	return 0;
 }
 
+#if IS_ENABLED(CONFIG_SFCB_CRC8_TABLE)
+/* crc8 ccitt (polynomial 0x07) lookup table */
+static const u8_t sfcb_crc8_table[256] = {
+	0x00, 0x07, 0x0e, 0x09, 0x1c, 0x1b, 0x12, 0x15,
+	0x38, 0x3f, 0x36, 0x31, 0x24, 0x23, 0x2a, 0x2d,
+	0x70, 0x77, 0x7e, 0x79, 0x6c, 0x6b, 0x62, 0x65,
+	0x48, 0x4f, 0x46, 0x41, 0x54, 0x53, 0x5a, 0x5d,
+	0xe0, 0xe7, 0xee, 0xe9, 0xfc, 0xfb, 0xf2, 0xf5,
+	0xd8, 0xdf, 0xd6, 0xd1, 0xc4, 0xc3, 0xca, 0xcd,
+	0x90, 0x97, 0x9e, 0x99, 0x8c, 0x8b, 0x82, 0x85,
+	0xa8, 0xaf, 0xa6, 0xa1, 0xb4, 0xb3, 0xba, 0xbd,
+	0xc7, 0xc0, 0xc9, 0xce, 0xdb, 0xdc, 0xd5, 0xd2,
+	0xff, 0xf8, 0xf1, 0xf6, 0xe3, 0xe4, 0xed, 0xea,
+	0xb7, 0xb0, 0xb9, 0xbe, 0xab, 0xac, 0xa5, 0xa2,
+	0x8f, 0x88, 0x81, 0x86, 0x93, 0x94, 0x9d, 0x9a,
+	0x27, 0x20, 0x29, 0x2e, 0x3b, 0x3c, 0x35, 0x32,
+	0x1f, 0x18, 0x11, 0x16, 0x03, 0x04, 0x0d, 0x0a,
+	0x57, 0x50, 0x59, 0x5e, 0x4b, 0x4c, 0x45, 0x42,
+	0x6f, 0x68, 0x61, 0x66, 0x73, 0x74, 0x7d, 0x7a,
+	0x89, 0x8e, 0x87, 0x80, 0x95, 0x92, 0x9b, 0x9c,
+	0xb1, 0xb6, 0xbf, 0xb8, 0xad, 0xaa, 0xa3, 0xa4,
+	0xf9, 0xfe, 0xf7, 0xf0, 0xe5, 0xe2, 0xeb, 0xec,
+	0xc1, 0xc6, 0xcf, 0xc8, 0xdd, 0xda, 0xd3, 0xd4,
+	0x69, 0x6e, 0x67, 0x60, 0x75, 0x72, 0x7b, 0x7c,
+	0x51, 0x56, 0x5f, 0x58, 0x4d, 0x4a, 0x43, 0x44,
+	0x19, 0x1e, 0x17, 0x10, 0x05, 0x02, 0x0b, 0x0c,
+	0x21, 0x26, 0x2f, 0x28, 0x3d, 0x3a, 0x33, 0x34,
+	0x4e, 0x49, 0x40, 0x47, 0x52, 0x55, 0x5c, 0x5b,
+	0x76, 0x71, 0x78, 0x7f, 0x6a, 0x6d, 0x64, 0x63,
+	0x3e, 0x39, 0x30, 0x37, 0x22, 0x25, 0x2c, 0x2b,
+	0x06, 0x01, 0x08, 0x0f, 0x1a, 0x1d, 0x14, 0x13,
+	0xae, 0xa9, 0xa0, 0xa7, 0xb2, 0xb5, 0xbc, 0xbb,
+	0x96, 0x91, 0x98, 0x9f, 0x8a, 0x8d, 0x84, 0x83,
+	0xde, 0xd9, 0xd0, 0xd7, 0xc2, 0xc5, 0xcc, 0xcb,
+	0xe6, 0xe1, 0xe8, 0xef, 0xfa, 0xfd, 0xf4, 0xf3,
+};
+
+static u8_t sfcb_crc8(u8_t crc, const u8_t *data, size_t len)
+{
+	while (len--) {
+		crc = sfcb_crc8_table[crc ^ *data++];
+	}
+
+	return crc;
+}
+#else
+static u8_t sfcb_crc8(u8_t crc, const u8_t *data, size_t len)
+{
+	return crc8_ccitt(crc, data, len);
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_CRC8_TABLE) */
+
 static void sfcb_crc8_update(void *data, size_t len)
 {
 	u8_t *data8 = (u8_t *)data;
@@ -191,7 +291,7 @@ static void sfcb_crc8_update(void *data, size_t len)
 		return;
 	}
 
-	data8[len - 1] = crc8_ccitt(0xff, data8, len - 1);
+	data8[len - 1] = sfcb_crc8(0xff, data8, len - 1);
 }
 
 static int sfcb_crc8_verify(const void *data, size_t len)
@@ -202,7 +302,7 @@ static int sfcb_crc8_verify(const void *data, size_t len)
 		return -EINVAL;
 	}
 
-	return (int)(data8[len -1] - crc8_ccitt(0xff, data8, len - 1));
+	return (int)(data8[len -1] - sfcb_crc8(0xff, data8, len - 1));
 }
 
 static int sfcb_flash_read_crc8_verify(sfcb_fs *fs, u16_t sec, u16_t sec_off,
@@ -219,22 +319,79 @@ static int sfcb_flash_read_crc8_verify(sfcb_fs *fs, u16_t sec, u16_t sec_off,
 		return rc;
 	}
 
-	rc = sfcb_crc8_verify(data, len);
-	return rc;
+	/* a crc mismatch is not an error, it is returned as 1 */
+	return sfcb_crc8_verify(data, len) ? 1 : 0;
 }
 
 void sfcb_next_sector(sfcb_fs *fs, u16_t *sector) {
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	*sector = fs->gr_next[*sector];
+#else
 	*sector += 1U;
 	if (*sector == fs->sector_cnt) {
 		*sector = 0U;
 	}
+#endif /* IS_ENABLED(CONFIG_SFCB_GREEDY) */
 }
 
 void sfcb_prev_sector(sfcb_fs *fs, u16_t *sector) {
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	*sector = fs->gr_prev[*sector];
+#else
 	if (*sector == 0) {
 		*sector = fs->sector_cnt;
 	}
 	*sector -= 1U;
+#endif /* IS_ENABLED(CONFIG_SFCB_GREEDY) */
+}
+
+static inline bool sfcb_ate_is_dir(const sfcb_ate *ate)
+{
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+	return (ate->pad8[0] == SFCB_ATE_DIR);
+#else
+	return false;
+#endif
+}
+
+static inline bool sfcb_ate_is_victim(const sfcb_ate *ate)
+{
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	return (ate->pad8[0] == SFCB_ATE_VICTIM);
+#else
+	return false;
+#endif
+}
+
+static inline bool sfcb_ate_is_data(const sfcb_ate *ate)
+{
+	return ((!sfcb_ate_is_dir(ate)) && (!sfcb_ate_is_victim(ate)));
+}
+
+/* A valid ate has a correct crc8 and is a data ate */
+static inline bool sfcb_ate_valid(const sfcb_ate *ate)
+{
+	return ((!sfcb_crc8_verify(ate, SFCB_ATE_SIZE)) &&
+		(sfcb_ate_is_data(ate)));
+}
+
+/* Flash space used by the data and ate */
+static inline u16_t sfcb_ate_space(const sfcb_ate *ate)
+{
+	return sfcb_align_up(ate->len) + SFCB_ATE_SIZE;
+}
+
+/* Initialize loc to walk the ates in sector below ate_offset */
+static void sfcb_sector_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t sector,
+			    u16_t ate_offset)
+{
+	loc->fs = fs;
+	loc->sector = sector;
+	loc->data_offset = 0;
+	loc->ate_offset = ate_offset;
+#if (CONFIG_SFCB_ATE_CACHE_SIZE !=1)
+	loc->ate_cache_offset = 0;
+#endif
 }
 
 static int sfcb_next_in_sector(sfcb_loc *loc)
@@ -275,6 +432,25 @@ static int sfcb_next_in_sector(sfcb_loc *loc)
 	return 0;
 }
 
+/* Flash space used by the data (and ates) in sector */
+static int sfcb_sector_data_space(sfcb_fs *fs, u16_t sector, u16_t *space)
+{
+	int rc;
+	sfcb_loc loc;
+	sfcb_ate *ate;
+
+	*space = 0U;
+	sfcb_sector_loc(fs, &loc, sector, fs->sector_size);
+	while (!(rc = sfcb_next_in_sector(&loc))) {
+		ate = sfcb_get_ate(&loc);
+		if (sfcb_ate_valid(ate)) {
+			*space += sfcb_ate_space(ate);
+		}
+	}
+
+	return (rc == -ENOENT) ? 0 : rc;
+}
+
 int sfcb_next_loc(sfcb_loc *loc)
 {
 	int rc;
@@ -287,9 +463,12 @@ int sfcb_next_loc(sfcb_loc *loc)
 	while (1) {
 		rc = sfcb_next_in_sector(loc);
 		if (rc == -ENOENT) {
-			/* sector end or FS end */
+			/* sector end or FS end, a read-only fs ends at the
+			 * first blank ate in the write sector
+			 */
 			if ((loc->sector == loc->fs->wr_sector) &&
-			    (loc->ate_offset == loc->fs->wr_ate_offset)) {
+			    ((loc->fs->read_only) ||
+			     (loc->ate_offset == loc->fs->wr_ate_offset))) {
 				/* FS end */
 				return -ENOENT;
 			}
@@ -305,7 +484,7 @@ int sfcb_next_loc(sfcb_loc *loc)
 			return rc;
 		}
 		ate = sfcb_get_ate(loc);
-		if (!sfcb_crc8_verify(ate, SFCB_ATE_SIZE)) {
+		if (sfcb_ate_valid(ate)) {
 			break;
 		}
 	}
@@ -329,13 +508,80 @@ int sfcb_start_loc(sfcb_fs *fs, sfcb_loc *loc)
 	return 0;
 }
 
+int sfcb_find_loc(sfcb_fs *fs, sfcb_loc *loc,
+		  bool (*match)(sfcb_loc *loc, void *arg), void *arg)
+{
+	int rc;
+	u16_t i, sector;
+	sfcb_loc loc_walk;
+	bool found = false;
+
+	if ((!fs) || (!loc) || (!match)) {
+		return -EINVAL;
+	}
+
+	/* sectors from newest to oldest, the locations in a sector from oldest
+	 * to newest (the last match in a sector is the newest)
+	 */
+	sector = fs->wr_sector;
+	for (i = 0; i < fs->sector_cnt; i++) {
+		sfcb_sector_loc(fs, &loc_walk, sector, fs->sector_size);
+		while (!(rc = sfcb_next_in_sector(&loc_walk))) {
+			if (!sfcb_ate_valid(sfcb_get_ate(&loc_walk))) {
+				continue;
+			}
+
+			if (match(&loc_walk, arg)) {
+				*loc = loc_walk;
+				found = true;
+			}
+			loc_walk.data_offset = 0;
+		}
+
+		if (rc != -ENOENT) {
+			return rc;
+		}
+
+		if (found) {
+			loc->data_offset = 0;
+			return 0;
+		}
+
+		sfcb_prev_sector(fs, &sector);
+	}
+
+	return -ENOENT;
+}
+
 int sfcb_compress_sector(sfcb_fs *fs, u16_t *sector)
 {
 	if (!fs) {
 		return -EINVAL;
 	}
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	*sector = fs->gr_victim;
+#else
 	*sector = fs->wr_sector;
 	sfcb_next_sector(fs, sector);
+#endif /* IS_ENABLED(CONFIG_SFCB_GREEDY) */
+	return 0;
+}
+
+int sfcb_compress_start_loc(sfcb_fs *fs, sfcb_loc *loc)
+{
+	int rc;
+	u16_t sector;
+
+	if ((!fs) || (!loc)) {
+		return -EINVAL;
+	}
+
+	rc = sfcb_compress_sector(fs, &sector);
+	if (rc) {
+		return rc;
+	}
+
+	sfcb_sector_loc(fs, loc, sector, fs->sector_size);
 	return 0;
 }
 
@@ -367,21 +613,312 @@ static int sfcb_init_sector(sfcb_fs *fs)
 	return 0;
 }
 
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+static int sfcb_dir_write(sfcb_fs *fs, u16_t sector);
+#endif
+
+static int sfcb_init_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t id, u16_t len);
+static int sfcb_close_loc_no_unlock(sfcb_loc *loc);
+static int sfcb_compress_all(sfcb_fs *fs);
+static int sfcb_compress_finish(sfcb_fs *fs);
+
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+/*
+ * The oldest sector is compressed when its sector id falls this far behind,
+ * this keeps all sector ids in the file system comparable with sfcb_scmp().
+ */
+#define SFCB_GREEDY_MAX_AGE 0x4000
+
+static int sfcb_live_search(sfcb_fs *fs, u16_t id, u16_t *pos)
+{
+	u16_t lo = 0U, hi = fs->gr_live_cnt, mid;
+
+	while (lo < hi) {
+		mid = (lo + hi) / 2U;
+		if (fs->gr_live_tbl[mid].id < id) {
+			lo = mid + 1U;
+		} else {
+			hi = mid;
+		}
+	}
+
+	*pos = lo;
+	if ((lo < fs->gr_live_cnt) && (fs->gr_live_tbl[lo].id == id)) {
+		return 0;
+	}
+	return -ENOENT;
+}
+
+/*
+ * Account newest data for id in sector, the data it replaces is no longer
+ * live. When the table is full new ids are not tracked and their data stays
+ * live until the sector is erased.
+ */
+static void sfcb_live_add(sfcb_fs *fs, u16_t id, u16_t sector, u16_t size)
+{
+	sfcb_live_entry *entry;
+	u16_t pos;
+
+	fs->gr_live[sector] += size;
+	if (!sfcb_live_search(fs, id, &pos)) {
+		entry = &fs->gr_live_tbl[pos];
+		fs->gr_live[entry->sector] -= entry->size;
+	} else {
+		if (fs->gr_live_cnt == CONFIG_SFCB_GREEDY_LIVE_IDS) {
+			return;
+		}
+		memmove(&fs->gr_live_tbl[pos + 1], &fs->gr_live_tbl[pos],
+			(fs->gr_live_cnt - pos) * sizeof(sfcb_live_entry));
+		fs->gr_live_cnt++;
+		entry = &fs->gr_live_tbl[pos];
+		entry->id = id;
+	}
+	entry->sector = sector;
+	entry->size = size;
+}
+
+/* Forget the live data in a sector that is erased */
+static void sfcb_live_drop(sfcb_fs *fs, u16_t sector)
+{
+	u16_t i, j = 0U;
+
+	for (i = 0; i < fs->gr_live_cnt; i++) {
+		if (fs->gr_live_tbl[i].sector != sector) {
+			fs->gr_live_tbl[j++] = fs->gr_live_tbl[i];
+		}
+	}
+	fs->gr_live_cnt = j;
+	fs->gr_live[sector] = 0U;
+}
+
+/* Walk the file system once to find the live data in each sector */
+static int sfcb_live_init(sfcb_fs *fs)
+{
+	int rc;
+	sfcb_loc loc;
+	sfcb_ate *ate;
+
+	fs->gr_live_cnt = 0U;
+	memset(fs->gr_live, 0, sizeof(fs->gr_live));
+
+	(void)sfcb_start_loc(fs, &loc);
+	while (!(rc = sfcb_next_loc(&loc))) {
+		ate = sfcb_get_ate(&loc);
+		sfcb_live_add(fs, ate->id, loc.sector, sfcb_ate_space(ate));
+	}
+
+	return (rc == -ENOENT) ? 0 : rc;
+}
+
+/* Sectors without a valid sector start are the oldest */
+static bool sfcb_ring_older(sfcb_fs *fs, const bool *blank, u16_t a, u16_t b)
+{
+	if (blank[a]) {
+		return true;
+	}
+	if (blank[b]) {
+		return false;
+	}
+	return (sfcb_scmp(fs->gr_sec_id[a], fs->gr_sec_id[b]) < 0);
+}
+
+/*
+ * Link the sectors from old to new in the logical ring, the write sector
+ * (newest) is followed by the oldest sector.
+ */
+static int sfcb_ring_init(sfcb_fs *fs)
+{
+	int rc;
+	u16_t order[CONFIG_SFCB_GREEDY_MAX_SECTORS];
+	bool blank[CONFIG_SFCB_GREEDY_MAX_SECTORS];
+	u16_t i, sector, next;
+	sfcb_sec_start sec_start;
+
+	for (sector = 0; sector < fs->sector_cnt; sector++) {
+		rc = sfcb_flash_read_crc8_verify(fs, sector, 0, &sec_start,
+						 SFCB_SEC_START_SIZE);
+		if (rc < 0) {
+			return rc;
+		}
+		blank[sector] = (rc != 0);
+		fs->gr_sec_id[sector] = rc ? fs->wr_sector_id : sec_start.sec_id;
+
+		/* insertion sort on age */
+		for (i = sector; i > 0; i--) {
+			if (sfcb_ring_older(fs, blank, order[i - 1], sector)) {
+				break;
+			}
+			order[i] = order[i - 1];
+		}
+		order[i] = sector;
+	}
+
+	for (i = 0; i < fs->sector_cnt; i++) {
+		sector = order[i];
+		next = order[(i + 1U) % fs->sector_cnt];
+		fs->gr_next[sector] = next;
+		fs->gr_prev[next] = sector;
+	}
+
+	fs->gr_victim = fs->gr_next[fs->wr_sector];
+	fs->gr_live_cnt = 0U;
+	memset(fs->gr_live, 0, sizeof(fs->gr_live));
+	return 0;
+}
+
+/* Move sector to the end of the ring (after the write sector) */
+static void sfcb_ring_append(sfcb_fs *fs, u16_t sector)
+{
+	u16_t last = fs->wr_sector;
+
+	if (sector == last) {
+		return;
+	}
+
+	fs->gr_next[fs->gr_prev[sector]] = fs->gr_next[sector];
+	fs->gr_prev[fs->gr_next[sector]] = fs->gr_prev[sector];
+	fs->gr_next[sector] = fs->gr_next[last];
+	fs->gr_prev[sector] = last;
+	fs->gr_prev[fs->gr_next[last]] = sector;
+	fs->gr_next[last] = sector;
+}
+
+/*
+ * Select the next compress sector: the sector with the least live data
+ * (the oldest on a tie), or the oldest sector when greedy compress is not
+ * enabled or the oldest sector is getting too old.
+ */
+/*
+ * The open cold sector still has room for copies, it is not compressed
+ * because of its low live data.
+ */
+static inline bool sfcb_victim_is_cold(sfcb_fs *fs, u16_t sector)
+{
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	return ((fs->cd_open) && (sector == fs->cd_sector));
+#else
+	return false;
+#endif
+}
+
+static void sfcb_victim_select(sfcb_fs *fs)
+{
+	u16_t sector, oldest;
+
+	oldest = fs->gr_next[fs->wr_sector];
+	fs->gr_victim = oldest;
+	if ((!fs->greedy) || (fs->log) ||
+	    ((u16_t)(fs->wr_sector_id - fs->gr_sec_id[oldest]) >
+	     SFCB_GREEDY_MAX_AGE)) {
+		return;
+	}
+
+	sector = fs->gr_next[oldest];
+	while (sector != fs->wr_sector) {
+		if ((fs->gr_live[sector] < fs->gr_live[fs->gr_victim]) &&
+		    (!sfcb_victim_is_cold(fs, sector))) {
+			fs->gr_victim = sector;
+		}
+		sector = fs->gr_next[sector];
+	}
+}
+
+/* Record the compress sector in the write sector, it is found again on mount */
+static int sfcb_victim_write(sfcb_fs *fs)
+{
+	int rc;
+	sfcb_loc loc;
+
+	sfcb_lock(fs);
+	rc = sfcb_init_loc(fs, &loc, fs->gr_victim, 0);
+	if (!rc) {
+		sfcb_get_ate(&loc)->pad8[0] = SFCB_ATE_VICTIM;
+		rc = sfcb_close_loc_no_unlock(&loc);
+	}
+	sfcb_unlock(fs);
+	return rc;
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_GREEDY) */
+
 static int sfcb_new_sector(sfcb_fs *fs)
 {
 	int rc;
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+	u16_t sealed_sector;
+#endif
 
 	if (!fs) {
 		return -EINVAL;
 	}
 
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+	sealed_sector = fs->wr_sector;
+#endif
+
+	/* the compression sector is erased, finish its compress */
+	rc = sfcb_compress_finish(fs);
+	if (rc) {
+		return rc;
+	}
+
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	/* the compressed sector becomes the newest sector */
+	sfcb_ring_append(fs, fs->gr_victim);
+	fs->wr_sector = fs->gr_victim;
+	fs->gr_sec_id[fs->wr_sector] = fs->wr_sector_id;
+	sfcb_live_drop(fs, fs->wr_sector);
+#else
 	sfcb_next_sector(fs, &fs->wr_sector);
+#endif /* IS_ENABLED(CONFIG_SFCB_GREEDY) */
 	rc = sfcb_flash_sector_erase(fs, fs->wr_sector);
 	if (rc) {
 		return rc;
 	}
 	rc = sfcb_init_sector(fs);
-	return rc;
+	if (rc) {
+		return rc;
+	}
+
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	if (fs->sector_cnt > 1) {
+		sfcb_victim_select(fs);
+	}
+#endif
+
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+	if (fs->sector_cnt > 1) {
+		/* the directory of the sealed sector is the first item in
+		 * the new sector
+		 */
+		rc = sfcb_dir_write(fs, sealed_sector);
+		if (rc) {
+			return rc;
+		}
+	}
+#endif
+
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	if (fs->sector_cnt > 1) {
+		rc = sfcb_victim_write(fs);
+		if (rc) {
+			return rc;
+		}
+	}
+#endif
+
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	if (fs->cd_open) {
+		u16_t compress_sector;
+
+		(void)sfcb_compress_sector(fs, &compress_sector);
+		if ((fs->cd_sector == fs->wr_sector) ||
+		    (fs->cd_sector == compress_sector)) {
+			/* cold head is compressed, copies go to wr_sector */
+			fs->cd_open = false;
+		}
+	}
+#endif
+	return 0;
 }
 
 static int sfcb_config_init(sfcb_fs *fs)
@@ -439,10 +976,16 @@ static int sfcb_config_init(sfcb_fs *fs)
 	}
 
 	fs->sector_cnt = fs->cfg->size / fs->sector_size;
-	if (fs->compress && (fs->sector_cnt < 2)) {
+	if (sfcb_has_compress(fs) && (fs->sector_cnt < 2)) {
 		LOG_ERR("Cfg error - insufficient sectors for compress");
 		goto ERR;
 	}
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	if (fs->sector_cnt > CONFIG_SFCB_GREEDY_MAX_SECTORS) {
+		LOG_ERR("Cfg error - too many sectors");
+		goto ERR;
+	}
+#endif
 	fs->flash_device = NULL;
 	return 0;
 
@@ -493,10 +1036,34 @@ static int sfcb_fs_check(sfcb_fs *fs) {
 	return 0;
 }
 
+/* Check if a sector is blank, returns 0 if blank, 1 if not blank */
+static int sfcb_sector_blank(sfcb_fs *fs, u16_t sector)
+{
+	int rc;
+	u32_t buf[SFCB_BLOCK_SIZE / sizeof(u32_t)];
+	u16_t offset, len;
+
+	offset = fs->sector_size;
+	while (offset) {
+		/* walk down, the ate area at the end is the first to be used */
+		len = MIN(offset, SFCB_BLOCK_SIZE);
+		offset -= len;
+		rc = sfcb_flash_read(fs, sector, offset, &buf, len);
+		if (rc) {
+			return rc;
+		}
+
+		if (sfcb_cmp_const(&buf, 0xff, len)) {
+			return 1;
+		}
+	}
+
+	return 0;
+}
+
 int sfcb_format(sfcb_fs *fs)
 {
 	int rc;
-	sfcb_ate ate;
 	u16_t i;
 
 	if (!fs) {
@@ -515,16 +1082,13 @@ int sfcb_format(sfcb_fs *fs)
 	fs->flash_device = device_get_binding(fs->cfg->dev_name);
 
 	for (i = 0; i < fs->sector_cnt; i++) {
-		/* erase sector 0 and all sectors that do not have empty first
-		 * ATE
-		 */
-		rc = sfcb_flash_read(fs, i, fs->sector_size -
-			SFCB_ATE_SIZE, &ate, SFCB_ATE_SIZE);
-		if (rc) {
+		/* erase all sectors that are not blank */
+		rc = sfcb_sector_blank(fs, i);
+		if (rc < 0) {
 			goto END;
 		}
 
-		if ((!i) || (sfcb_cmp_const(&ate, 0xff, SFCB_ATE_SIZE))) {
+		if (rc) {
 			rc = sfcb_flash_sector_erase(fs, i);
 			if (rc) {
 				goto END;
@@ -573,6 +1137,13 @@ int sfcb_fs_init(sfcb_fs *fs)
 		if (!rc) {
 			fs->wr_data_offset = ate.offset;
 			fs->wr_data_offset += sfcb_align_up(ate.len);
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+			if ((sfcb_ate_is_victim(&ate)) &&
+			    (ate.id < fs->sector_cnt) &&
+			    (ate.id != fs->wr_sector)) {
+				fs->gr_victim = ate.id;
+			}
+#endif
 			continue;
 		}
 
@@ -603,26 +1174,38 @@ int sfcb_fs_init(sfcb_fs *fs)
 		fs->wr_data_offset = data_offset;
 	}
 
-	if (fs->compress && (fs->sector_cnt > 1)) {
+	if (sfcb_has_compress(fs) && (fs->sector_cnt > 1)) {
 		/* compress might have been interrupted call it again, if it
 		 * fails (this will be due to insufficient space) erase the
 		 * current write sector and restart compress */
-		rc = fs->compress(fs);
+		rc = sfcb_compress_all(fs);
 		if (rc) {
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+			/* the write sector is taken again */
+			fs->gr_victim = fs->wr_sector;
+#else
 			sfcb_prev_sector(fs, &fs->wr_sector);
+#endif
 			fs->wr_sector_id--;
 			rc = sfcb_new_sector(fs);
 			if (rc) {
 				return rc;
 			}
 
-			rc = fs->compress(fs);
+			rc = sfcb_compress_all(fs);
 			if (rc) {
 				return rc;
 			}
 		}
 	}
 
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	rc = sfcb_live_init(fs);
+	if (rc) {
+		return rc;
+	}
+#endif
+
 	LOG_INF("SFCB initialized: WR_SECTOR %x, WR_ATE %x, WR_DATA %x",
 		fs->wr_sector, fs->wr_ate_offset, fs->wr_data_offset);
 	return 0;
@@ -642,6 +1225,13 @@ int sfcb_mount(sfcb_fs *fs)
 	k_mutex_init(&fs->mutex);
 
 	sfcb_lock(fs);
+	fs->read_only = false;
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	fs->cd_open = false;
+#endif
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+	fs->cp_busy = false;
+#endif
 
 	rc = sfcb_config_init(fs);
 	if (rc) {
@@ -654,6 +1244,13 @@ int sfcb_mount(sfcb_fs *fs)
 		goto END;
 	}
 
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	rc = sfcb_ring_init(fs);
+	if (rc) {
+		goto END;
+	}
+#endif
+
 	rc = sfcb_fs_init(fs);
 	if (rc) {
 		goto END;
@@ -667,6 +1264,54 @@ END:
 	return rc;
 }
 
+int sfcb_mount_ro(sfcb_fs *fs)
+{
+	int rc;
+
+	if (!fs) {
+		return -EINVAL;
+	}
+
+	if (fs->flash_device) {
+		return -EBUSY;
+	}
+
+	k_mutex_init(&fs->mutex);
+
+	rc = sfcb_config_init(fs);
+	if (rc) {
+		return rc;
+	}
+
+	fs->flash_device = device_get_binding(fs->cfg->dev_name);
+	rc = sfcb_fs_check(fs);
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	if (!rc) {
+		rc = sfcb_ring_init(fs);
+	}
+#endif
+	if (rc) {
+		fs->flash_device = NULL;
+		return rc;
+	}
+
+	/* No write position is searched: the iterators end at the first
+	 * blank ate in the write sector.
+	 */
+	fs->read_only = true;
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	fs->cd_open = false;
+#endif
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+	fs->cp_busy = false;
+#endif
+	fs->wr_ate_offset = 0U;
+	fs->wr_data_offset = 0U;
+
+	LOG_INF("SFCB initialized read-only: WR_SECTOR %x", fs->wr_sector);
+	return 0;
+}
+
 int sfcb_unmount(sfcb_fs *fs)
 {
 	if (!fs) {
@@ -684,6 +1329,11 @@ static int sfcb_init_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t id, u16_t len)
 	if ((!fs) || (!loc)) {
 		return -EACCES;
 	}
+
+	if (fs->read_only) {
+		return -EROFS;
+	}
+
 	/* Always leave space for empty ATE */
 	req_space = sfcb_align_up(len) + SFCB_ATE_SIZE;
 	if ((fs->wr_ate_offset - fs->wr_data_offset) < req_space) {
@@ -707,9 +1357,182 @@ static int sfcb_init_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t id, u16_t len)
 	ate->id = id;
 	ate->len = len;
 	ate->offset = fs->wr_data_offset;
+	memset(ate->pad8, 0xff, sizeof(ate->pad8));
 	return 0;
 }
 
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+/*
+ * Start the incremental compress of the compression sector, the live data in
+ * the compression sector is reserved in the write sector until it is done.
+ */
+static int sfcb_cp_start(sfcb_fs *fs)
+{
+	u16_t sector;
+
+	(void)sfcb_compress_sector(fs, &sector);
+	sfcb_sector_loc(fs, &fs->cp_loc, sector, fs->sector_size);
+	fs->cp_busy = true;
+	return 0;
+}
+
+/*
+ * Pass at most cnt items of the compression sector to compress_loc. A failing
+ * item is passed again on the next step.
+ */
+static int sfcb_cp_step(sfcb_fs *fs, u16_t cnt)
+{
+	int rc;
+	sfcb_loc loc, prev;
+	sfcb_ate *ate;
+
+	while (cnt) {
+		prev = fs->cp_loc;
+		rc = sfcb_next_in_sector(&fs->cp_loc);
+		if (rc == -ENOENT) {
+			/* compression sector done */
+			fs->cp_busy = false;
+			return 0;
+		}
+		if (rc) {
+			return rc;
+		}
+
+		ate = sfcb_get_ate(&fs->cp_loc);
+		if (!sfcb_ate_valid(ate)) {
+			continue;
+		}
+
+		fs->cp_loc.data_offset = 0U;
+		loc = fs->cp_loc;
+		rc = fs->compress_loc(&loc);
+		if (rc) {
+			fs->cp_loc = prev;
+			return rc;
+		}
+		cnt--;
+	}
+
+	return 0;
+}
+
+/*
+ * Data of len bytes fits in the write sector without using the space reserved
+ * for the live data in the compression sector.
+ */
+static inline bool sfcb_cp_fits(sfcb_fs *fs, u16_t len)
+{
+	return ((!fs->cp_busy) ||
+		(fs->wr_ate_offset - fs->wr_data_offset >=
+		 sfcb_align_up(len) + SFCB_ATE_SIZE +
+		 fs->gr_live[fs->gr_victim]));
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL) */
+
+/*
+ * Compress the compression sector, an incremental compress is only started
+ * and continues on later writes.
+ */
+static int sfcb_compress(sfcb_fs *fs)
+{
+	int rc = 0;
+
+	if (sfcb_has_compress(fs) && (fs->sector_cnt > 1)) {
+		sfcb_lock(fs);
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+		if (fs->compress_loc) {
+			rc = sfcb_cp_start(fs);
+		} else {
+			rc = fs->compress(fs);
+		}
+#else
+		rc = fs->compress(fs);
+#endif
+		sfcb_unlock(fs);
+	}
+	return rc;
+}
+
+/* Finish a started incremental compress */
+static int sfcb_compress_finish(sfcb_fs *fs)
+{
+	int rc = 0;
+
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+	if (fs->cp_busy) {
+		sfcb_lock(fs);
+		rc = sfcb_cp_step(fs, UINT16_MAX);
+		sfcb_unlock(fs);
+	}
+#endif
+	return rc;
+}
+
+static int sfcb_compress_all(sfcb_fs *fs)
+{
+	int rc;
+
+	rc = sfcb_compress(fs);
+	if (rc) {
+		return rc;
+	}
+	return sfcb_compress_finish(fs);
+}
+
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+/*
+ * A cold head takes a sector of its own, it is only started when compress
+ * copied at least this part of a sector. Smaller copies stay with new data.
+ */
+#define SFCB_COLD_HEAD_MIN_COPY_DIV 4
+
+/*
+ * The cold head is only used with greedy selection, in circular order every
+ * sector is compressed once per cycle and all live data is copied anyway.
+ */
+static inline bool sfcb_cold_head_needed(sfcb_fs *fs)
+{
+	return ((fs->cold_head) && (fs->greedy) && (!fs->cd_open) &&
+		(sfcb_has_compress(fs)) && (fs->sector_cnt > 2) &&
+		(fs->gr_live[fs->wr_sector] >=
+		 fs->sector_size / SFCB_COLD_HEAD_MIN_COPY_DIV));
+}
+
+/* Continue writing copies in the current write sector */
+static void sfcb_cold_head_open(sfcb_fs *fs)
+{
+	fs->cd_sector = fs->wr_sector;
+	fs->cd_data_offset = fs->wr_data_offset;
+	fs->cd_ate_offset = fs->wr_ate_offset;
+	fs->cd_open = true;
+}
+
+/*
+ * Copies go to the cold head when they come from an older sector, a copy in
+ * the cold head should not be hidden by older data in a newer sector.
+ */
+static inline bool sfcb_cold_head_accepts(sfcb_fs *fs, u16_t sector)
+{
+	return (sfcb_scmp(fs->gr_sec_id[sector],
+			  fs->gr_sec_id[fs->cd_sector]) < 0);
+}
+
+static void sfcb_swap_head(sfcb_fs *fs)
+{
+	u16_t tmp;
+
+	tmp = fs->wr_sector;
+	fs->wr_sector = fs->cd_sector;
+	fs->cd_sector = tmp;
+	tmp = fs->wr_data_offset;
+	fs->wr_data_offset = fs->cd_data_offset;
+	fs->cd_data_offset = tmp;
+	tmp = fs->wr_ate_offset;
+	fs->wr_ate_offset = fs->cd_ate_offset;
+	fs->cd_ate_offset = tmp;
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_COLD_HEAD) */
+
 int sfcb_open_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t id, u16_t len)
 {
 	int rc, nscnt = 0;
@@ -718,8 +1541,30 @@ int sfcb_open_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t id, u16_t len)
 		return -EINVAL;
 	}
 
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+	if (fs->cp_busy) {
+		/* one compress step for each write */
+		sfcb_lock(fs);
+		rc = sfcb_cp_step(fs, CONFIG_SFCB_COMPRESS_STEP);
+		sfcb_unlock(fs);
+		if (rc) {
+			return rc;
+		}
+	}
+#endif
+
 	while (1) {
 		rc = sfcb_init_loc(fs, loc, id, len);
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL)
+		if (((rc == -ENOMEM) || ((!rc) && (!sfcb_cp_fits(fs, len)))) &&
+		    (fs->cp_busy)) {
+			/* the space is reserved for compress and a new sector
+			 * needs the compress to be done, the write is retried
+			 * after more steps
+			 */
+			return -EAGAIN;
+		}
+#endif
 		if (rc != -ENOMEM) {
 			break;
 		}
@@ -729,11 +1574,30 @@ int sfcb_open_loc(sfcb_fs *fs, sfcb_loc *loc, u16_t id, u16_t len)
 			return rc;
 		}
 		/* call gc */
-		if (fs->compress && (fs->sector_cnt > 1)) {
-			sfcb_lock(fs);
-			rc = fs->compress(fs);
-			sfcb_unlock(fs);
+		rc = sfcb_compress(fs);
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+		if (sfcb_cold_head_needed(fs)) {
+			/* The new sector holds the copies and becomes the cold
+			 * head, data is written in the next sector. The cold
+			 * head is always older than the write sector, a copy
+			 * never hides newer data.
+			 */
+			rc = sfcb_compress_finish(fs);
+			if (rc) {
+				return rc;
+			}
+			sfcb_cold_head_open(fs);
+			rc = sfcb_new_sector(fs);
+			if (rc) {
+				return rc;
+			}
+			rc = sfcb_compress(fs);
+			nscnt++;
+			if (nscnt == fs->sector_cnt) {
+				return -ENOMEM;
+			}
 		}
+#endif /* IS_ENABLED(CONFIG_SFCB_COLD_HEAD) */
 		nscnt++;
 		if (nscnt == fs->sector_cnt) {
 			return -ENOMEM;
@@ -776,6 +1640,12 @@ static int sfcb_close_loc_no_unlock(sfcb_loc *loc)
 	loc->fs->wr_data_offset += sfcb_align_up(ate->len);
 	loc->fs->wr_ate_offset -= SFCB_ATE_SIZE;
 
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	if (sfcb_ate_is_data(ate)) {
+		sfcb_live_add(loc->fs, ate->id, loc->fs->wr_sector,
+			      sfcb_ate_space(ate));
+	}
+#endif
 	return 0;
 }
 
@@ -791,6 +1661,9 @@ int sfcb_close_loc(sfcb_loc *loc) {
 	}
 
 	rc = sfcb_close_loc_no_unlock(loc);
+	if (!rc) {
+		SFCB_STATS_ADD(loc->fs, wr_bytes, sfcb_get_ate(loc)->len);
+	}
 	sfcb_unlock(loc->fs);
 	return rc;
 }
@@ -898,28 +1771,42 @@ ssize_t sfcb_read_loc(sfcb_loc *loc, void *data, size_t len)
 	return len;
 }
 
-int sfcb_copy_loc(sfcb_loc *loc) {
-	int rc;
-	sfcb_loc newloc;
-	sfcb_ate *ate;
-	u16_t len, rd_len;
-	u8_t buf[CONFIG_SFCB_WBS];
+int sfcb_cmp_loc(sfcb_loc *loc, const void *data, size_t len)
+{
+	ssize_t rc;
+	u8_t buf[SFCB_BLOCK_SIZE];
+	const u8_t *data8 = (const u8_t *)data;
 
-	if ((!loc) || (!loc->fs)) {
+	if ((!loc) || (!loc->fs) || ((!data) && (len))) {
 		return -EINVAL;
 	}
 
-	ate = sfcb_get_ate(loc);
+	while (len) {
+		rc = sfcb_read_loc(loc, buf, MIN(len, sizeof(buf)));
+		if (rc < 0) {
+			return rc;
+		}
 
-	if (sfcb_crc8_verify(ate, SFCB_ATE_SIZE)) {
-		return -EINVAL;
-	}
+		if ((!rc) || (memcmp(buf, data8, rc))) {
+			return 1;
+		}
 
-	if ((loc->ate_offset == loc->fs->wr_ate_offset) &&
-	    (loc->sector == loc->fs->wr_sector)) {
-		return -EACCES;
+		data8 += rc;
+		len -= rc;
 	}
 
+	return 0;
+}
+
+static int sfcb_copy_loc_to_head(sfcb_loc *loc)
+{
+	int rc;
+	sfcb_loc newloc;
+	sfcb_ate *ate;
+	u16_t len, rd_len;
+	u8_t buf[CONFIG_SFCB_WBS];
+
+	ate = sfcb_get_ate(loc);
 	rc = sfcb_init_loc(loc->fs, &newloc, ate->id, ate->len);
 	if (rc) {
 		return rc;
@@ -943,6 +1830,54 @@ int sfcb_copy_loc(sfcb_loc *loc) {
 	return rc;
 }
 
+int sfcb_copy_loc(sfcb_loc *loc) {
+	int rc;
+	sfcb_ate *ate;
+
+	if ((!loc) || (!loc->fs)) {
+		return -EINVAL;
+	}
+
+	if (loc->fs->log) {
+		return -EPERM;
+	}
+
+	ate = sfcb_get_ate(loc);
+
+	if (sfcb_crc8_verify(ate, SFCB_ATE_SIZE)) {
+		return -EINVAL;
+	}
+
+	if ((loc->ate_offset == loc->fs->wr_ate_offset) &&
+	    (loc->sector == loc->fs->wr_sector)) {
+		return -EACCES;
+	}
+
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	if ((loc->fs->cd_open) &&
+	    (sfcb_cold_head_accepts(loc->fs, loc->sector))) {
+		sfcb_swap_head(loc->fs);
+		rc = sfcb_copy_loc_to_head(loc);
+		sfcb_swap_head(loc->fs);
+		if (rc != -ENOMEM) {
+			goto END;
+		}
+		/* cold head is full, copies go to wr_sector */
+		loc->fs->cd_open = false;
+	}
+#endif /* IS_ENABLED(CONFIG_SFCB_COLD_HEAD) */
+
+	rc = sfcb_copy_loc_to_head(loc);
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+END:
+#endif
+	if (!rc) {
+		SFCB_STATS_ADD(loc->fs, cp_bytes, ate->len);
+		SFCB_STATS_ADD(loc->fs, cp_cnt, 1);
+	}
+	return rc;
+}
+
 ssize_t sfcb_write(sfcb_fs *fs, u16_t id, const void *data, size_t len)
 {
 	int rc;
@@ -963,12 +1898,429 @@ ssize_t sfcb_write(sfcb_fs *fs, u16_t id, const void *data, size_t len)
 	return len;
 }
 
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+/**
+ * @brief SFCB directory header
+ *
+ * The directory of a sector is stored as the first item in the next sector.
+ * It is followed by the directory entries sorted by bucket (id modulo the
+ * bucket count), within a bucket the entries are in ate order.
+ *
+ * @param sec_id: sector id of the sector described by the directory
+ * @param ate_end: ate offset of the first free ate when the directory was
+ *                 written, ates below ate_end are not in the directory
+ * @param bucket: index of the first entry of each bucket, the last item is
+ *                the number of entries
+ * @param bucket_crc8: crc8 of the entries of each bucket
+ * @param crc8: crc8 of the header
+ */
+typedef struct {
+	u16_t sec_id;
+	u16_t ate_end;
+	u16_t bucket[CONFIG_SFCB_DIRECTORY_BUCKETS + 1];
+	u8_t bucket_crc8[CONFIG_SFCB_DIRECTORY_BUCKETS];
+	u8_t crc8;
+} __packed sfcb_dir_hdr;
+
+typedef struct {
+	u16_t id;
+	u16_t ate_offset;
+} __packed sfcb_dir_entry;
+
+#define SFCB_DIR_ENTRY_BUF_CNT 8
+
+static inline u16_t sfcb_dir_bucket(u16_t id)
+{
+	return id % CONFIG_SFCB_DIRECTORY_BUCKETS;
+}
+
+/*
+ * Flash space that compress can copy to the write sector: the space used by
+ * the data in the compress sector (and the compress sector marker).
+ */
+static int sfcb_dir_reserve(sfcb_fs *fs, u16_t *reserve)
+{
+	int rc;
+	u16_t sector;
+
+	*reserve = 0U;
+	if (!sfcb_has_compress(fs)) {
+		return 0;
+	}
+
+	(void)sfcb_compress_sector(fs, &sector);
+	rc = sfcb_sector_data_space(fs, sector, reserve);
+	if (IS_ENABLED(CONFIG_SFCB_GREEDY)) {
+		*reserve += SFCB_ATE_SIZE;
+	}
+	return rc;
+}
+
+static int sfcb_dir_write(sfcb_fs *fs, u16_t sector)
+{
+	int rc;
+	u16_t cnt[CONFIG_SFCB_DIRECTORY_BUCKETS];
+	u16_t b, reserve, len, total = 0;
+	sfcb_sec_start sec_start;
+	sfcb_dir_hdr hdr;
+	sfcb_dir_entry entry;
+	sfcb_loc loc_walk, loc;
+	sfcb_ate *ate;
+
+	rc = sfcb_flash_read_crc8_verify(fs, sector, 0, &sec_start,
+					 SFCB_SEC_START_SIZE);
+	if (rc) {
+		/* sector without valid start has nothing to describe */
+		return (rc < 0) ? rc : 0;
+	}
+
+	memset(cnt, 0, sizeof(cnt));
+	memset(hdr.bucket_crc8, 0xff, sizeof(hdr.bucket_crc8));
+	sfcb_sector_loc(fs, &loc_walk, sector, fs->sector_size);
+	while (!(rc = sfcb_next_in_sector(&loc_walk))) {
+		ate = sfcb_get_ate(&loc_walk);
+		if (!sfcb_ate_valid(ate)) {
+			continue;
+		}
+		b = sfcb_dir_bucket(ate->id);
+		entry.id = ate->id;
+		entry.ate_offset = loc_walk.ate_offset;
+		hdr.bucket_crc8[b] = sfcb_crc8(hdr.bucket_crc8[b],
+					       (u8_t *)&entry, sizeof(entry));
+		cnt[b]++;
+		total++;
+	}
+
+	if (rc != -ENOENT) {
+		return rc;
+	}
+
+	rc = sfcb_dir_reserve(fs, &reserve);
+	if (rc) {
+		return rc;
+	}
+
+	len = sizeof(hdr) + total * sizeof(entry);
+	if ((total > CONFIG_SFCB_DIRECTORY_MAX_ENTRIES) ||
+	    (sfcb_align_up(len) + SFCB_ATE_SIZE + reserve >
+	     fs->wr_ate_offset - fs->wr_data_offset)) {
+		/* no directory, lookups fall back to a scan */
+		return 0;
+	}
+
+	hdr.sec_id = sec_start.sec_id;
+	hdr.ate_end = loc_walk.ate_offset;
+	hdr.bucket[0] = 0U;
+	for (b = 0; b < CONFIG_SFCB_DIRECTORY_BUCKETS; b++) {
+		hdr.bucket[b + 1] = hdr.bucket[b] + cnt[b];
+	}
+	sfcb_crc8_update(&hdr, sizeof(hdr));
+
+	sfcb_lock(fs);
+	rc = sfcb_init_loc(fs, &loc, SFCB_DIR_ID, len);
+	if (rc) {
+		goto END;
+	}
+
+	ate = sfcb_get_ate(&loc);
+	ate->pad8[0] = SFCB_ATE_DIR;
+
+	rc = sfcb_write_loc(&loc, &hdr, sizeof(hdr));
+	if (rc < 0) {
+		goto END;
+	}
+
+	for (b = 0; b < CONFIG_SFCB_DIRECTORY_BUCKETS; b++) {
+		if (!cnt[b]) {
+			continue;
+		}
+		sfcb_sector_loc(fs, &loc_walk, sector, fs->sector_size);
+		while (!sfcb_next_in_sector(&loc_walk)) {
+			ate = sfcb_get_ate(&loc_walk);
+			if ((!sfcb_ate_valid(ate)) ||
+			    (sfcb_dir_bucket(ate->id) != b)) {
+				continue;
+			}
+			entry.id = ate->id;
+			entry.ate_offset = loc_walk.ate_offset;
+			rc = sfcb_write_loc(&loc, &entry, sizeof(entry));
+			if (rc < 0) {
+				goto END;
+			}
+		}
+	}
+
+	rc = sfcb_close_loc_no_unlock(&loc);
+END:
+	sfcb_unlock(fs);
+	return rc;
+}
+
+/*
+ * Search the newest ate with id in sector below ate_offset, returns 0 when
+ * found and -ENOENT if not found.
+ */
+static int sfcb_sector_find(sfcb_fs *fs, u16_t sector, u16_t ate_offset,
+			    u16_t id, sfcb_loc *loc)
+{
+	int rc;
+	sfcb_loc loc_walk;
+	sfcb_ate *ate;
+	bool found = false;
+
+	sfcb_sector_loc(fs, &loc_walk, sector, ate_offset);
+	while (!(rc = sfcb_next_in_sector(&loc_walk))) {
+		ate = sfcb_get_ate(&loc_walk);
+		if ((sfcb_ate_valid(ate)) && (ate->id == id)) {
+			*loc = loc_walk;
+			found = true;
+		}
+	}
+
+	if (rc != -ENOENT) {
+		return rc;
+	}
+
+	return found ? 0 : -ENOENT;
+}
+
+/*
+ * Search the newest ate with id in sector using the directory, returns 0
+ * when found, -ENOENT if not found and -EAGAIN if there is no valid
+ * directory.
+ */
+static int sfcb_dir_find(sfcb_fs *fs, u16_t sector, u16_t id, sfcb_loc *loc)
+{
+	int rc;
+	u16_t dir_sector, dir_offset, b, i, j, cnt, ate_offset = 0U;
+	u8_t crc8 = 0xff;
+	sfcb_sec_start sec_start;
+	sfcb_dir_hdr hdr;
+	sfcb_dir_entry entries[SFCB_DIR_ENTRY_BUF_CNT];
+	sfcb_loc loc_dir;
+	sfcb_ate *ate;
+	bool found = false;
+
+	dir_sector = sector;
+	sfcb_next_sector(fs, &dir_sector);
+	sfcb_sector_loc(fs, &loc_dir, dir_sector, fs->sector_size);
+	rc = sfcb_next_in_sector(&loc_dir);
+	if (rc) {
+		return (rc == -ENOENT) ? -EAGAIN : rc;
+	}
+
+	ate = sfcb_get_ate(&loc_dir);
+	if ((sfcb_crc8_verify(ate, SFCB_ATE_SIZE)) || (!sfcb_ate_is_dir(ate))) {
+		return -EAGAIN;
+	}
+
+	dir_offset = ate->offset;
+	rc = sfcb_flash_read_crc8_verify(fs, dir_sector, dir_offset, &hdr,
+					 sizeof(hdr));
+	if (rc) {
+		return (rc < 0) ? rc : -EAGAIN;
+	}
+
+	rc = sfcb_flash_read_crc8_verify(fs, sector, 0, &sec_start,
+					 SFCB_SEC_START_SIZE);
+	if (rc < 0) {
+		return rc;
+	}
+
+	if ((rc) || (sec_start.sec_id != hdr.sec_id) ||
+	    (hdr.bucket[CONFIG_SFCB_DIRECTORY_BUCKETS] * sizeof(sfcb_dir_entry) +
+	     sizeof(hdr) != ate->len)) {
+		/* directory does not describe sector */
+		return -EAGAIN;
+	}
+
+	/* ates written after the directory are newer */
+	rc = sfcb_sector_find(fs, sector, hdr.ate_end + SFCB_ATE_SIZE, id, loc);
+	if (rc != -ENOENT) {
+		return rc;
+	}
+
+	b = sfcb_dir_bucket(id);
+	i = hdr.bucket[b];
+	while (i < hdr.bucket[b + 1]) {
+		cnt = MIN(hdr.bucket[b + 1] - i, SFCB_DIR_ENTRY_BUF_CNT);
+		rc = sfcb_flash_read(fs, dir_sector, dir_offset + sizeof(hdr) +
+				     i * sizeof(sfcb_dir_entry), entries,
+				     cnt * sizeof(sfcb_dir_entry));
+		if (rc) {
+			return rc;
+		}
+		crc8 = sfcb_crc8(crc8, (u8_t *)entries,
+				 cnt * sizeof(sfcb_dir_entry));
+		for (j = 0; j < cnt; j++) {
+			if (entries[j].id == id) {
+				ate_offset = entries[j].ate_offset;
+				found = true;
+			}
+		}
+		i += cnt;
+	}
+
+	if (crc8 != hdr.bucket_crc8[b]) {
+		/* corrupt entries */
+		return -EAGAIN;
+	}
+
+	if (!found) {
+		return -ENOENT;
+	}
+
+	sfcb_sector_loc(fs, loc, sector, ate_offset + SFCB_ATE_SIZE);
+	rc = sfcb_next_in_sector(loc);
+	if (rc) {
+		return (rc == -ENOENT) ? -EAGAIN : rc;
+	}
+
+	ate = sfcb_get_ate(loc);
+	if ((!sfcb_ate_valid(ate)) || (ate->id != id)) {
+		return -EAGAIN;
+	}
+
+	return 0;
+}
+
+/*
+ * Search the newest ate with id starting from the write sector, older
+ * sectors are searched using their directory.
+ */
+static int sfcb_dir_find_newest(sfcb_fs *fs, u16_t id, sfcb_loc *loc)
+{
+	int rc;
+	u16_t sector, i;
+
+	sector = fs->wr_sector;
+	rc = sfcb_sector_find(fs, sector, fs->sector_size, id, loc);
+	for (i = 1; (rc == -ENOENT) && (i < fs->sector_cnt); i++) {
+		sfcb_prev_sector(fs, &sector);
+		rc = sfcb_dir_find(fs, sector, id, loc);
+		if (rc == -EAGAIN) {
+			rc = sfcb_sector_find(fs, sector, fs->sector_size, id,
+					      loc);
+		}
+	}
+
+	return rc;
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_DIRECTORY) */
+
+#if !IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+static bool sfcb_match_id(sfcb_loc *loc, void *arg)
+{
+	return (sfcb_get_ate(loc)->id == *(u16_t *)arg);
+}
+#endif
+
+/* Find the location of the newest data of id, returns -ENOENT if none */
+static int sfcb_find_newest(sfcb_fs *fs, u16_t id, sfcb_loc *loc)
+{
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+	return sfcb_dir_find_newest(fs, id, loc);
+#else
+	return sfcb_find_loc(fs, loc, sfcb_match_id, &id);
+#endif /* IS_ENABLED(CONFIG_SFCB_DIRECTORY) */
+}
+
 ssize_t sfcb_read(sfcb_fs *fs, u16_t id, void *data, size_t len)
 {
 	int rc;
-	sfcb_loc loc, loc_walk;
+	sfcb_loc loc;
+
+	if (!fs) {
+		return -EINVAL;
+	}
+
+	rc = sfcb_find_newest(fs, id, &loc);
+	if (rc) {
+		return rc;
+	}
+
+	return sfcb_read_loc(&loc, data, len);
+}
+
+ssize_t sfcb_write_if_changed(sfcb_fs *fs, u16_t id, const void *data,
+			      size_t len)
+{
+	int rc;
+	sfcb_loc loc;
+
+	if (!fs) {
+		return -EINVAL;
+	}
+
+	rc = sfcb_find_newest(fs, id, &loc);
+	if ((rc) && (rc != -ENOENT)) {
+		return rc;
+	}
+
+	if ((!rc) && (sfcb_get_ate(&loc)->len == len)) {
+		rc = sfcb_cmp_loc(&loc, data, len);
+		if (rc < 0) {
+			return rc;
+		}
+
+		if (!rc) {
+			sfcb_stats_skip(fs);
+			return len;
+		}
+	}
+
+	return sfcb_write(fs, id, data, len);
+}
+
+void sfcb_stats_skip(sfcb_fs *fs)
+{
+	if (!fs) {
+		return;
+	}
+
+	sfcb_lock(fs);
+	SFCB_STATS_ADD(fs, skip_cnt, 1);
+	sfcb_unlock(fs);
+}
+
+/* Binary search of id in sorted ids, returns index or -ENOENT */
+static int sfcb_id_search(const u16_t *ids, size_t n, u16_t id)
+{
+	size_t lo = 0, hi = n, mid;
+
+	while (lo < hi) {
+		mid = lo + (hi - lo) / 2;
+		if (ids[mid] < id) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if ((lo < n) && (ids[lo] == id)) {
+		return lo;
+	}
+	return -ENOENT;
+}
+
+int sfcb_read_many(sfcb_fs *fs, const u16_t *ids, sfcb_loc *locs, size_t n,
+		   int (*cb)(u16_t id, sfcb_loc *loc, void *arg), void *arg)
+{
+	int rc, idx, found = 0;
+	sfcb_loc loc_walk;
 	sfcb_ate *ate;
-	bool read = false;
+	size_t i;
+
+	if ((!fs) || (!ids) || (!locs)) {
+		return -EINVAL;
+	}
+
+	for (i = 0; i < n; i++) {
+		if ((i) && (ids[i - 1] >= ids[i])) {
+			return -EINVAL;
+		}
+		locs[i].fs = NULL;
+	}
 
 	rc = sfcb_start_loc(fs, &loc_walk);
 	if (rc) {
@@ -977,16 +2329,140 @@ ssize_t sfcb_read(sfcb_fs *fs, u16_t id, void *data, size_t len)
 
 	while (!sfcb_next_loc(&loc_walk)) {
 		ate = sfcb_get_ate(&loc_walk);
-		if (ate->id == id) {
-			loc = loc_walk;
-			read = true;
+		idx = sfcb_id_search(ids, n, ate->id);
+		if (idx >= 0) {
+			locs[idx] = loc_walk;
 		}
 	}
 
-	if (!read) {
-		return -ENOENT;
+	for (i = 0; i < n; i++) {
+		if (!locs[i].fs) {
+			continue;
+		}
+		found++;
+		if (!cb) {
+			continue;
+		}
+		rc = cb(ids[i], &locs[i], arg);
+		if (rc) {
+			return rc;
+		}
 	}
 
-	return sfcb_read_loc(&loc, data, len);
+	return found;
+}
+
+int sfcb_loc_seq(sfcb_loc *loc, u32_t *seq)
+{
+	int rc;
+	sfcb_sec_start sec_start;
 
-}
\ No newline at end of file
+	if ((!loc) || (!loc->fs) || (!seq)) {
+		return -EINVAL;
+	}
+
+	rc = sfcb_flash_read_crc8_verify(loc->fs, loc->sector, 0, &sec_start,
+					 SFCB_SEC_START_SIZE);
+	if (rc) {
+		return (rc < 0) ? rc : -EIO;
+	}
+
+	*seq = ((u32_t)sec_start.sec_id << 16);
+	*seq += (loc->fs->sector_size - loc->ate_offset) / SFCB_ATE_SIZE - 1;
+	return 0;
+}
+
+int sfcb_seek_seq(sfcb_fs *fs, sfcb_loc *loc, u32_t seq)
+{
+	int rc;
+	u16_t i, sec_id, ate_idx;
+	s16_t cmp;
+	sfcb_sec_start sec_start;
+
+	rc = sfcb_start_loc(fs, loc);
+	if (rc) {
+		return rc;
+	}
+
+	sec_id = (u16_t)(seq >> 16);
+	ate_idx = (u16_t)(seq & 0xffff);
+
+	/* The sector starts are used as seek index: search the first sector
+	 * with a sector id equal or bigger than the sector id of seq.
+	 */
+	for (i = 0; i < fs->sector_cnt; i++) {
+		rc = sfcb_flash_read_crc8_verify(fs, loc->sector, 0, &sec_start,
+						 SFCB_SEC_START_SIZE);
+		if (rc < 0) {
+			return rc;
+		}
+
+		if (!rc) {
+			cmp = sfcb_scmp(sec_start.sec_id, sec_id);
+			if (cmp > 0) {
+				/* seq is older: start at the sector start */
+				return 0;
+			}
+			if ((!cmp) &&
+			    (ate_idx < fs->sector_size / SFCB_ATE_SIZE)) {
+				loc->ate_offset -= ate_idx * SFCB_ATE_SIZE;
+				break;
+			}
+		}
+
+		if (loc->sector == fs->wr_sector) {
+			/* seq is newer than all locations */
+			loc->ate_offset = SFCB_ATE_SIZE;
+			break;
+		}
+
+		sfcb_next_sector(fs, &loc->sector);
+	}
+
+	/* don't go past the write position */
+	if ((loc->sector == fs->wr_sector) && (!fs->read_only) &&
+	    (loc->ate_offset < fs->wr_ate_offset + SFCB_ATE_SIZE)) {
+		loc->ate_offset = fs->wr_ate_offset + SFCB_ATE_SIZE;
+	}
+
+	return 0;
+}
+
+int sfcb_cursor_set(sfcb_fs *fs, u16_t id, sfcb_loc *loc)
+{
+	int rc;
+	u32_t seq;
+
+	rc = sfcb_loc_seq(loc, &seq);
+	if (rc) {
+		return rc;
+	}
+
+	seq++;
+	rc = sfcb_write(fs, id, &seq, sizeof(seq));
+	if (rc < 0) {
+		return rc;
+	}
+	return 0;
+}
+
+int sfcb_cursor_get(sfcb_fs *fs, u16_t id, sfcb_loc *loc)
+{
+	ssize_t rc;
+	u32_t seq;
+
+	rc = sfcb_read(fs, id, &seq, sizeof(seq));
+	if (rc == -ENOENT) {
+		return sfcb_start_loc(fs, loc);
+	}
+
+	if (rc < 0) {
+		return rc;
+	}
+
+	if (rc != sizeof(seq)) {
+		return -EIO;
+	}
+
+	return sfcb_seek_seq(fs, loc, seq);
+}
@@ -16,6 +16,13 @@ const sfcb_fs_cfg cfg = {
 	.dev_name = DT_FLASH_AREA_STORAGE_DEV,
 };
 
+/* At most 8 sectors, the storage partition can be smaller (nrf51: 6) */
+const sfcb_fs_cfg cfgmax8sector = {
+	.offset = DT_FLASH_AREA_STORAGE_OFFSET,
+	.size = MIN(8 * DT_FLASH_ERASE_BLOCK_SIZE, DT_FLASH_AREA_STORAGE_SIZE),
+	.dev_name = DT_FLASH_AREA_STORAGE_DEV,
+};
+
 const sfcb_fs_cfg cfg2sector = {
 	.offset = DT_FLASH_AREA_STORAGE_OFFSET,
 	.size = 2 * DT_FLASH_ERASE_BLOCK_SIZE,
@@ -96,12 +103,50 @@ void test_sfcb_mount(void)
 
 }
 
+void test_sfcb_format(void)
+{
+	int rc;
+	struct device *flash_dev;
+	off_t off;
+	u32_t data = 0x12345678, rd;
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+	u32_t er_cnt;
+#endif
+
+	sfcb.cfg = &cfg;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+
+	/* data without an ate in the middle of sector 1 */
+	flash_dev = device_get_binding(cfg.dev_name);
+	off = cfg.offset + DT_FLASH_ERASE_BLOCK_SIZE * 3 / 2;
+	(void)flash_write_protection_set(flash_dev, 0);
+	rc = flash_write(flash_dev, off, &data, sizeof(data));
+	zassert_true(rc == 0, "Flash write failed [%d]", rc);
+
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = flash_read(flash_dev, off, &rd, sizeof(rd));
+	zassert_true(rc == 0, "Flash read failed [%d]", rc);
+	zassert_true(rd == 0xffffffff, "Format left data in sector");
+
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+	/* only sector 0 (with the sector start) needs an erase */
+	er_cnt = sfcb.stats.flash_er_cnt;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	zassert_true(sfcb.stats.flash_er_cnt - er_cnt == 1,
+		     "Format erased blank sectors");
+#endif
+}
+
 void test_sfcb_loc(void)
 {
 	int rc;
 	sfcb_loc loc;
 	u16_t data_size = 16U;
 	u16_t exp_offset, exp_sector = 1U;
+	u16_t exp_ate_offset, exp_data_offset;
 
 	sfcb.cfg = &cfg;
 	rc = sfcb_format(&sfcb);
@@ -143,12 +188,23 @@ void test_sfcb_loc(void)
 		rc = sfcb_close_loc(&loc);
 		zassert_true(rc == 0, "close loc failed [%d]", rc);
 	}
-	exp_offset = sfcb.sector_size;
-	exp_offset -= (2 * SFCB_ATE_SIZE);
-	zassert_true(sfcb.wr_ate_offset == exp_offset, "Wrong ate offset");
 
-	exp_offset = SFCB_SEC_START_SIZE + data_size;
-	zassert_true(sfcb.wr_data_offset == exp_offset, "Wrong data offset");
+	/* With a directory or greedy compress the second sector starts with
+	 * the directory or the compress sector marker
+	 */
+	if ((!IS_ENABLED(CONFIG_SFCB_DIRECTORY)) &&
+	    (!IS_ENABLED(CONFIG_SFCB_GREEDY))) {
+		exp_offset = sfcb.sector_size;
+		exp_offset -= (2 * SFCB_ATE_SIZE);
+		zassert_true(sfcb.wr_ate_offset == exp_offset,
+			     "Wrong ate offset");
+
+		exp_offset = SFCB_SEC_START_SIZE + data_size;
+		zassert_true(sfcb.wr_data_offset == exp_offset,
+			     "Wrong data offset");
+	}
+	exp_ate_offset = sfcb.wr_ate_offset;
+	exp_data_offset = sfcb.wr_data_offset;
 
 	/* Unmount and remount to see if we get the same result */
 	rc = sfcb_unmount(&sfcb);
@@ -158,13 +214,9 @@ void test_sfcb_loc(void)
 	zassert_true(rc == 0, "Mount failed [%d]", rc);
 
 	zassert_true(sfcb.wr_sector == exp_sector, "Wrong sector");
-
-	exp_offset = sfcb.sector_size;
-	exp_offset -= (2 * SFCB_ATE_SIZE);
-	zassert_true(sfcb.wr_ate_offset == exp_offset, "Wrong ate offset");
-
-	exp_offset = SFCB_SEC_START_SIZE + data_size;
-	zassert_true(sfcb.wr_data_offset == exp_offset, "Wrong data offset");
+	zassert_true(sfcb.wr_ate_offset == exp_ate_offset, "Wrong ate offset");
+	zassert_true(sfcb.wr_data_offset == exp_data_offset,
+		     "Wrong data offset");
 
 	rc = sfcb_unmount(&sfcb);
 	zassert_true(rc == 0, "Unmount failed [%d]", rc);
@@ -504,6 +556,644 @@ void test_sfcb_readwritehighlevel(void)
 	zassert_true(rc == 0, "Unmount failed [%d]", rc);
 }
 
+void test_sfcb_write_if_changed(void)
+{
+	int rc, id = 0;
+	char data[6]="test=0", buf[10];
+	u16_t wr_ate_offset;
+
+	sfcb.cfg = &cfg;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* a new id is written */
+	wr_ate_offset = sfcb.wr_ate_offset;
+	rc = sfcb_write_if_changed(&sfcb, id, data, sizeof(data));
+	zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+	zassert_true(sfcb.wr_ate_offset != wr_ate_offset, "Nothing written");
+
+	/* equal data is not written */
+	wr_ate_offset = sfcb.wr_ate_offset;
+	rc = sfcb_write_if_changed(&sfcb, id, data, sizeof(data));
+	zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+	zassert_true(sfcb.wr_ate_offset == wr_ate_offset,
+		     "Unchanged data written");
+
+	/* changed data and a changed length are written */
+	data[5] = '1';
+	rc = sfcb_write_if_changed(&sfcb, id, data, sizeof(data));
+	zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+	zassert_true(sfcb.wr_ate_offset != wr_ate_offset,
+		     "Changed data not written");
+
+	wr_ate_offset = sfcb.wr_ate_offset;
+	rc = sfcb_write_if_changed(&sfcb, id, data, sizeof(data) - 1);
+	zassert_true(rc == sizeof(data) - 1, "Write failed [%d]", rc);
+	zassert_true(sfcb.wr_ate_offset != wr_ate_offset,
+		     "Changed length not written");
+
+	rc = sfcb_read(&sfcb, id, buf, sizeof(buf));
+	zassert_true(rc == sizeof(data) - 1, "Read wrong size [%d]", rc);
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+}
+
+static bool find_loc_match(sfcb_loc *loc, void *arg)
+{
+	u32_t data;
+
+	if (sfcb_read_loc(loc, &data, sizeof(data)) != sizeof(data)) {
+		return false;
+	}
+	return (data == *(u32_t *)arg);
+}
+
+void test_sfcb_find_loc(void)
+{
+	int rc;
+	u32_t data, cnt, match;
+	u16_t id;
+	sfcb_loc loc, loc_walk, loc_last;
+
+	sfcb.cfg = &cfg;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* data is the write count modulo 16, for id 0 to 3 */
+	for (cnt = 0U; (sfcb.wr_sector < 2) || (cnt % 4U); cnt++) {
+		data = cnt % 16U;
+		rc = sfcb_write(&sfcb, cnt % 4U, &data, sizeof(data));
+		zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+	}
+
+	/* the newest match is found, as by a walk from oldest to newest */
+	for (match = 0U; match < 16U; match++) {
+		rc = sfcb_find_loc(&sfcb, &loc, find_loc_match, &match);
+		zassert_true(rc == 0, "Find failed [%d]", rc);
+
+		rc = sfcb_start_loc(&sfcb, &loc_walk);
+		zassert_true(rc == 0, "Start loc failed [%d]", rc);
+		while (!sfcb_next_loc(&loc_walk)) {
+			if (find_loc_match(&loc_walk, &match)) {
+				loc_last = loc_walk;
+			}
+		}
+		zassert_true((loc.sector == loc_last.sector) &&
+			     (loc.ate_offset == loc_last.ate_offset),
+			     "Wrong location for %u", match);
+
+		/* the read position is at the start of the data */
+		rc = sfcb_read_loc(&loc, &data, sizeof(data));
+		zassert_true((rc == sizeof(data)) && (data == match),
+			     "Wrong data for %u", match);
+	}
+
+	match = 16U;
+	rc = sfcb_find_loc(&sfcb, &loc, find_loc_match, &match);
+	zassert_true(rc == -ENOENT, "Found missing data [%d]", rc);
+
+	/* sfcb_read() returns the newest data */
+	for (id = 0U; id < 4U; id++) {
+		rc = sfcb_read(&sfcb, id, &data, sizeof(data));
+		zassert_true(rc == sizeof(data), "Read failed [%d]", rc);
+		zassert_true(data == ((cnt - 4U + id) % 16U),
+			     "Wrong data for id %u", id);
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+}
+
+void test_sfcb_mount_ro(void)
+{
+	int rc, id, cnt, ro_cnt;
+	u16_t wr_sector;
+	sfcb_loc loc;
+	char data[6]="test=0", buf[10];
+
+	sfcb.cfg = &cfg;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* write until the second sector is partly filled */
+	id = 0;
+	while ((sfcb.wr_sector == 0) || (id % 8)) {
+		rc = sfcb_write(&sfcb, id, data, sizeof(data));
+		zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+		id++;
+	}
+	wr_sector = sfcb.wr_sector;
+
+	cnt = 0;
+	rc = sfcb_start_loc(&sfcb, &loc);
+	while (!sfcb_next_loc(&loc)) {
+		cnt++;
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+
+	rc = sfcb_mount_ro(&sfcb);
+	zassert_true(rc == 0, "Mount read-only failed [%d]", rc);
+	zassert_true(sfcb.wr_sector == wr_sector, "Wrong sector");
+
+	ro_cnt = 0;
+	rc = sfcb_start_loc(&sfcb, &loc);
+	while (!sfcb_next_loc(&loc)) {
+		ro_cnt++;
+	}
+	zassert_true(ro_cnt == cnt, "Wrong loc count [%d != %d]", ro_cnt, cnt);
+
+	rc = sfcb_read(&sfcb, id - 1, buf, sizeof(buf));
+	zassert_true(rc == sizeof(data), "Read wrong size [%d]", rc);
+	rc = memcmp(data, buf, sizeof(data));
+	zassert_true(rc == 0, "Wrong data");
+
+	rc = sfcb_write(&sfcb, id, data, sizeof(data));
+	zassert_true(rc == -EROFS, "Write on read-only fs [%d]", rc);
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+
+	/* a normal mount finds the same write position */
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+	rc = sfcb_write(&sfcb, id, data, sizeof(data));
+	zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+}
+
+static int read_many_cb(u16_t id, sfcb_loc *loc, void *arg)
+{
+	u32_t *values = (u32_t *)arg;
+	u32_t value;
+	ssize_t rc;
+
+	rc = sfcb_read_loc(loc, &value, sizeof(value));
+	zassert_true(rc == sizeof(value), "Read wrong size [%d]", rc);
+	values[id] = value;
+	return 0;
+}
+
+void test_sfcb_read_many(void)
+{
+	int rc;
+	u16_t id;
+	u32_t value, values[8];
+	const u16_t ids[] = {1, 3, 6, 100};
+	const u16_t bad_ids[] = {3, 1};
+	sfcb_loc locs[ARRAY_SIZE(ids)];
+
+	sfcb.cfg = &cfg;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* write each id 0..7 several times, value = 10 * pass + id */
+	for (value = 0; value < 30; value += 10) {
+		for (id = 0; id < 8; id++) {
+			u32_t wr_value = value + id;
+
+			rc = sfcb_write(&sfcb, id, &wr_value, sizeof(wr_value));
+			zassert_true(rc == sizeof(wr_value), "Write failed");
+		}
+	}
+
+	memset(values, 0, sizeof(values));
+	rc = sfcb_read_many(&sfcb, ids, locs, ARRAY_SIZE(ids), read_many_cb,
+			    values);
+	zassert_true(rc == 3, "Wrong found count [%d]", rc);
+	zassert_true(values[1] == 21, "Wrong value for id 1");
+	zassert_true(values[3] == 23, "Wrong value for id 3");
+	zassert_true(values[6] == 26, "Wrong value for id 6");
+	zassert_true(values[0] == 0, "Unrequested id 0 was read");
+	zassert_true(locs[3].fs == NULL, "Missing id reported as found");
+
+	rc = sfcb_read_many(&sfcb, bad_ids, locs, ARRAY_SIZE(bad_ids), NULL,
+			    NULL);
+	zassert_true(rc == -EINVAL, "Unsorted ids accepted");
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+}
+
+/* Read the newest data for id by walking all locations */
+static ssize_t read_walk(sfcb_fs *fs, u16_t id, void *data, size_t len)
+{
+	sfcb_loc loc, loc_walk;
+	sfcb_ate *ate;
+	bool found = false;
+
+	(void)sfcb_start_loc(fs, &loc_walk);
+	while (!sfcb_next_loc(&loc_walk)) {
+		ate = sfcb_get_ate(&loc_walk);
+		if (ate->id == id) {
+			loc = loc_walk;
+			found = true;
+		}
+	}
+
+	if (!found) {
+		return -ENOENT;
+	}
+	return sfcb_read_loc(&loc, data, len);
+}
+
+void test_sfcb_directory(void)
+{
+	int rc, rc_walk, cnt, wr_cnt = 0;
+	u16_t id;
+	u32_t value, value_walk, pass = 0;
+	sfcb_loc loc;
+
+	sfcb.cfg = &cfg;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* spread ids over several sectors, low ids are updated often */
+	while (sfcb.wr_sector < 4) {
+		for (id = 0; id < 40; id++) {
+			if ((id > 8) && (pass % 4)) {
+				continue;
+			}
+			value = (pass << 16) + id;
+			rc = sfcb_write(&sfcb, id, &value, sizeof(value));
+			zassert_true(rc == sizeof(value), "Write failed");
+			wr_cnt++;
+		}
+		pass++;
+	}
+
+	/* directories are not visible as locations */
+	cnt = 0;
+	(void)sfcb_start_loc(&sfcb, &loc);
+	while (!sfcb_next_loc(&loc)) {
+		cnt++;
+	}
+	zassert_true(cnt == wr_cnt, "Wrong loc count [%d != %d]", cnt, wr_cnt);
+
+	for (id = 0; id < 42; id++) {
+		rc = sfcb_read(&sfcb, id, &value, sizeof(value));
+		rc_walk = read_walk(&sfcb, id, &value_walk, sizeof(value_walk));
+		zassert_true(rc == rc_walk, "Wrong read result for id %d", id);
+		if (rc > 0) {
+			zassert_true(value == value_walk,
+				     "Wrong value for id %d", id);
+		}
+	}
+
+	/* a read-only mount uses the same directories */
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	rc = sfcb_mount_ro(&sfcb);
+	zassert_true(rc == 0, "Mount read-only failed [%d]", rc);
+
+	for (id = 0; id < 42; id++) {
+		rc = sfcb_read(&sfcb, id, &value, sizeof(value));
+		rc_walk = read_walk(&sfcb, id, &value_walk, sizeof(value_walk));
+		zassert_true(rc == rc_walk, "Wrong read result for id %d", id);
+		if (rc > 0) {
+			zassert_true(value == value_walk,
+				     "Wrong value for id %d", id);
+		}
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+}
+
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+static u8_t dir_sector_buf[DT_FLASH_ERASE_BLOCK_SIZE];
+
+/* Directory header: sector id, ate end, the bucket table, the bucket crc8's
+ * and the header crc8
+ */
+#define DIR_HDR_SIZE (7 + 3 * CONFIG_SFCB_DIRECTORY_BUCKETS)
+
+enum dir_damage_type {
+	DIR_TORN,	/* directory ate with a bad crc */
+	DIR_STALE,	/* other sector id, entries point to the next ate */
+	DIR_CORRUPT,	/* valid header, corrupt entry ids */
+};
+
+/* Damage the directory that is the first item of sector */
+static void dir_damage(sfcb_fs *fs, u16_t sector, enum dir_damage_type type)
+{
+	int rc;
+	struct device *flash;
+	off_t offset;
+	sfcb_ate *ate;
+	u16_t sec_id, first, i, cnt;
+	u8_t *hdr, *entry;
+
+	zassert_true(fs->sector_size <= sizeof(dir_sector_buf),
+		     "Sector too large");
+	flash = device_get_binding(fs->cfg->dev_name);
+	zassert_not_null(flash, "No flash device");
+	offset = fs->cfg->offset + sector * fs->sector_size;
+
+	rc = flash_read(flash, offset, dir_sector_buf, fs->sector_size);
+	zassert_true(rc == 0, "Flash read failed [%d]", rc);
+	ate = (sfcb_ate *)&dir_sector_buf[fs->sector_size - SFCB_ATE_SIZE];
+
+	hdr = &dir_sector_buf[ate->offset];
+	entry = &dir_sector_buf[ate->offset + DIR_HDR_SIZE];
+	cnt = (ate->len - DIR_HDR_SIZE) / 4;
+	zassert_true(cnt > 1, "Directory too small");
+
+	switch (type) {
+	case DIR_TORN:
+		ate->crc8 ^= 0x5a;
+		break;
+	case DIR_STALE:
+		/* the header crc is kept valid */
+		memcpy(&sec_id, hdr, sizeof(sec_id));
+		sec_id += 0x100;
+		memcpy(hdr, &sec_id, sizeof(sec_id));
+		hdr[DIR_HDR_SIZE - 1] = crc8_ccitt(0xff, hdr, DIR_HDR_SIZE - 1);
+		memcpy(&first, &entry[2], sizeof(first));
+		for (i = 0; i < cnt - 1; i++) {
+			memcpy(&entry[4 * i + 2], &entry[4 * i + 6], 2);
+		}
+		memcpy(&entry[4 * i + 2], &first, sizeof(first));
+		break;
+	case DIR_CORRUPT:
+		/* the ids are no longer found in the entries */
+		for (i = 0; i < cnt; i++) {
+			entry[4 * i + 1] ^= 0x40;
+		}
+		break;
+	}
+
+	(void)flash_write_protection_set(flash, false);
+	rc = flash_erase(flash, offset, fs->sector_size);
+	zassert_true(rc == 0, "Flash erase failed [%d]", rc);
+	rc = flash_write(flash, offset, dir_sector_buf, fs->sector_size);
+	zassert_true(rc == 0, "Flash write failed [%d]", rc);
+	(void)flash_write_protection_set(flash, true);
+}
+
+void test_sfcb_directory_fallback(void)
+{
+	int rc, rc_walk;
+	u16_t id;
+	u32_t value, value_walk, pass = 0;
+
+	sfcb.cfg = &cfg;
+	sfcb.compress = NULL;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* ids above 8 are written once, they are spread over all sectors */
+	while (sfcb.wr_sector < 4) {
+		for (id = 0; id < 40; id++) {
+			if ((id >= 8) && (id != 8 + pass)) {
+				continue;
+			}
+			value = (pass << 16) + id;
+			rc = sfcb_write(&sfcb, id, &value, sizeof(value));
+			zassert_true(rc == sizeof(value), "Write failed");
+		}
+		pass++;
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+
+	/* sector n + 1 holds the directory of sector n */
+	dir_damage(&sfcb, 1, DIR_CORRUPT);
+	dir_damage(&sfcb, 2, DIR_STALE);
+	dir_damage(&sfcb, 3, DIR_TORN);
+
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* lookups in sector 0, 1 and 2 fall back to a scan */
+	for (id = 0; id < 42; id++) {
+		rc = sfcb_read(&sfcb, id, &value, sizeof(value));
+		rc_walk = read_walk(&sfcb, id, &value_walk, sizeof(value_walk));
+		zassert_true(rc == rc_walk, "Wrong read result for id %d", id);
+		if (rc > 0) {
+			zassert_true(value == value_walk,
+				     "Wrong value for id %d", id);
+		}
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+}
+#else
+void test_sfcb_directory_fallback(void)
+{
+	ztest_test_skip();
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_DIRECTORY) */
+
+void test_sfcb_seq(void)
+{
+	int rc, cnt;
+	u16_t id;
+	u32_t seq, prev_seq, seq_10 = 0U, seq_last = 0U;
+	sfcb_loc loc;
+	sfcb_ate *ate;
+	const u16_t cursor_id = 0xfffe;
+
+	sfcb.cfg = &cfg;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	id = 0;
+	while (sfcb.wr_sector < 3) {
+		rc = sfcb_write(&sfcb, id, &id, sizeof(id));
+		zassert_true(rc == sizeof(id), "Write failed [%d]", rc);
+		id++;
+	}
+
+	/* sequence numbers increase */
+	cnt = 0;
+	(void)sfcb_start_loc(&sfcb, &loc);
+	while (!sfcb_next_loc(&loc)) {
+		rc = sfcb_loc_seq(&loc, &seq);
+		zassert_true(rc == 0, "Get seq failed [%d]", rc);
+		if (cnt) {
+			zassert_true((s32_t)(seq - prev_seq) > 0,
+				     "Sequence not increasing");
+		}
+		ate = sfcb_get_ate(&loc);
+		if (ate->id == 10) {
+			seq_10 = seq;
+		}
+		seq_last = seq;
+		prev_seq = seq;
+		cnt++;
+	}
+	zassert_true(cnt == id, "Wrong loc count");
+
+	/* seek to an existing location */
+	rc = sfcb_seek_seq(&sfcb, &loc, seq_10);
+	zassert_true(rc == 0, "Seek failed [%d]", rc);
+	rc = sfcb_next_loc(&loc);
+	zassert_true(rc == 0, "No loc after seek [%d]", rc);
+	ate = sfcb_get_ate(&loc);
+	zassert_true(ate->id == 10, "Wrong loc after seek [%d]", ate->id);
+
+	/* seek to an old sequence number returns the first location */
+	rc = sfcb_seek_seq(&sfcb, &loc, 0U);
+	zassert_true(rc == 0, "Seek failed [%d]", rc);
+	rc = sfcb_next_loc(&loc);
+	zassert_true(rc == 0, "No loc after seek [%d]", rc);
+	ate = sfcb_get_ate(&loc);
+	zassert_true(ate->id == 0, "Wrong loc after seek [%d]", ate->id);
+
+	/* seek past the last location */
+	rc = sfcb_seek_seq(&sfcb, &loc, seq_last + 1);
+	zassert_true(rc == 0, "Seek failed [%d]", rc);
+	rc = sfcb_next_loc(&loc);
+	zassert_true(rc == -ENOENT, "Loc found after last loc [%d]", rc);
+
+	/* without cursor all locations are returned */
+	rc = sfcb_cursor_get(&sfcb, cursor_id, &loc);
+	zassert_true(rc == 0, "Cursor get failed [%d]", rc);
+	rc = sfcb_next_loc(&loc);
+	zassert_true(rc == 0, "No loc without cursor [%d]", rc);
+	ate = sfcb_get_ate(&loc);
+	zassert_true(ate->id == 0, "Wrong loc without cursor [%d]", ate->id);
+
+	/* export up to id 10, then continue from cursor */
+	rc = sfcb_seek_seq(&sfcb, &loc, seq_10);
+	zassert_true(rc == 0, "Seek failed [%d]", rc);
+	rc = sfcb_next_loc(&loc);
+	zassert_true(rc == 0, "No loc after seek [%d]", rc);
+	rc = sfcb_cursor_set(&sfcb, cursor_id, &loc);
+	zassert_true(rc == 0, "Cursor set failed [%d]", rc);
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	rc = sfcb_cursor_get(&sfcb, cursor_id, &loc);
+	zassert_true(rc == 0, "Cursor get failed [%d]", rc);
+	rc = sfcb_next_loc(&loc);
+	zassert_true(rc == 0, "No loc after cursor [%d]", rc);
+	ate = sfcb_get_ate(&loc);
+	zassert_true(ate->id == 11, "Wrong loc after cursor [%d]", ate->id);
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+}
+
+int compress_newest(sfcb_fs *fs);
+
+/* Export the locations after the cursor, the values must follow last */
+static void log_export(sfcb_fs *fs, u16_t cursor_id, u32_t *last)
+{
+	int rc;
+	u32_t value;
+	sfcb_loc loc, loc_last;
+	bool exported = false;
+
+	rc = sfcb_cursor_get(fs, cursor_id, &loc);
+	zassert_true(rc == 0, "Cursor get failed [%d]", rc);
+	while (!sfcb_next_loc(&loc)) {
+		if (sfcb_get_ate(&loc)->id == cursor_id) {
+			continue;
+		}
+		rc = sfcb_read_loc(&loc, &value, sizeof(value));
+		zassert_true(rc == sizeof(value), "Read failed [%d]", rc);
+		zassert_true(value == *last + 1, "Value %u exported after %u",
+			     value, *last);
+		*last = value;
+		loc_last = loc;
+		exported = true;
+	}
+
+	if (exported) {
+		rc = sfcb_cursor_set(fs, cursor_id, &loc_last);
+		zassert_true(rc == 0, "Cursor set failed [%d]", rc);
+	}
+}
+
+void test_sfcb_log(void)
+{
+	int rc;
+	u16_t id, start_id;
+	u32_t value = 0U, last = 0U;
+	sfcb_loc loc;
+	const u16_t cursor_id = 0xfffe;
+
+	/* a compress that copies everything and the cold head are ignored */
+	sfcb.cfg = &cfg;
+	sfcb.compress = compress_newest;
+	sfcb.log = true;
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	sfcb.greedy = true;
+#endif
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	sfcb.cold_head = true;
+#endif
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	/* wrap the log twice, export every 16 writes, id 4 (value 1) is never
+	 * updated so a compress would copy it
+	 */
+	start_id = sfcb.wr_sector_id;
+	while ((u16_t)(sfcb.wr_sector_id - start_id) < 2 * sfcb.sector_cnt) {
+		value++;
+		id = (value == 1) ? 4 : value % 4;
+		rc = sfcb_write(&sfcb, id, &value, sizeof(value));
+		zassert_true(rc == sizeof(value), "Write failed [%d]", rc);
+		if (!(value % 16)) {
+			log_export(&sfcb, cursor_id, &last);
+		}
+		if (value == 1000) {
+			rc = sfcb_unmount(&sfcb);
+			zassert_true(rc == 0, "Unmount failed [%d]", rc);
+			rc = sfcb_mount(&sfcb);
+			zassert_true(rc == 0, "Mount failed [%d]", rc);
+		}
+	}
+
+	log_export(&sfcb, cursor_id, &last);
+	zassert_true(last == value, "Export ends at %u not %u", last, value);
+
+	/* a log does not copy */
+	rc = sfcb_start_loc(&sfcb, &loc);
+	zassert_true(rc == 0, "Start loc failed [%d]", rc);
+	rc = sfcb_next_loc(&loc);
+	zassert_true(rc == 0, "No loc [%d]", rc);
+	rc = sfcb_copy_loc(&loc);
+	zassert_true(rc == -EPERM, "Copy in a log [%d]", rc);
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	sfcb.compress = NULL;
+	sfcb.log = false;
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+	sfcb.greedy = false;
+#endif
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	sfcb.cold_head = false;
+#endif
+}
+
 int compress(sfcb_fs *fs)
 {
 	int rc;
@@ -512,7 +1202,7 @@ int compress(sfcb_fs *fs)
 	bool copy;
 	u16_t compress_sector;
 
-	if (sfcb_start_loc(fs, &loc_compress)) {
+	if (sfcb_compress_start_loc(fs, &loc_compress)) {
 		return 0;
 	}
 
@@ -635,16 +1325,478 @@ void test_sfcb_compress(void)
 
 
 }
+
+/* Keep the last entry of every id */
+int compress_newest(sfcb_fs *fs)
+{
+	int rc;
+	sfcb_loc loc_compress, loc_walk;
+	sfcb_ate *ate_compress, *ate_walk;
+	bool copy;
+	u16_t compress_sector;
+
+	if (sfcb_compress_start_loc(fs, &loc_compress)) {
+		return 0;
+	}
+
+	if (sfcb_next_loc(&loc_compress)) {
+		return 0;
+	}
+	rc = sfcb_compress_sector(fs, &compress_sector);
+	zassert_true(rc == 0, "Compress sector failed [%d]", rc);
+
+	while (loc_compress.sector == compress_sector) {
+		copy = true;
+		ate_compress = sfcb_get_ate(&loc_compress);
+		loc_walk = loc_compress;
+		while (!sfcb_next_loc(&loc_walk)) {
+			ate_walk = sfcb_get_ate(&loc_walk);
+			if (ate_compress->id == ate_walk->id) {
+				copy = false;
+				break;
+			}
+		}
+
+		if (copy) {
+			rc = sfcb_copy_loc(&loc_compress);
+			if (rc) {
+				return rc;
+			}
+		}
+
+		if (sfcb_next_loc(&loc_compress)) {
+			break;
+		}
+	}
+	return 0;
+}
+
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+#define COLD_ID_START 100
+#define COLD_ID_CNT 48
+#define COLD_MIX_CNT 8
+#define HOT_ID_CNT 8
+#define HOT_WR_CNT 3000
+
+/*
+ * Mixed workload: long lived cold records are written between updates of
+ * hot records, after that only the hot records are updated.
+ */
+static u32_t cold_head_workload(bool cold_head)
+{
+	int rc;
+	u8_t data[32], buf[32];
+	u32_t value = 0U, wa = 0;
+	u16_t id;
+
+	(void)sfcb_unmount(&sfcb);
+	sfcb.cfg = &cfgmax8sector;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+
+	sfcb.compress = &compress_newest;
+	sfcb.greedy = true;
+	sfcb.cold_head = cold_head;
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+	memset(&sfcb.stats, 0, sizeof(sfcb.stats));
+#endif
+
+	for (id = COLD_ID_START; id < COLD_ID_START + COLD_ID_CNT; id++) {
+		memset(data, (u8_t)id, sizeof(data));
+		rc = sfcb_write(&sfcb, id, data, sizeof(data));
+		zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+		for (int i = 0; i < COLD_MIX_CNT; i++) {
+			rc = sfcb_write(&sfcb, value % HOT_ID_CNT, &value,
+					sizeof(value));
+			zassert_true(rc == sizeof(value), "Write failed [%d]",
+				     rc);
+			value++;
+		}
+	}
+
+	while (value < HOT_WR_CNT) {
+		rc = sfcb_write(&sfcb, value % HOT_ID_CNT, &value,
+				sizeof(value));
+		zassert_true(rc == sizeof(value), "Write failed [%d]", rc);
+		value++;
+	}
+
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+	/* write amplification in percent */
+	wa = (100 * (sfcb.stats.wr_bytes + sfcb.stats.cp_bytes)) /
+	     sfcb.stats.wr_bytes;
+	LOG_INF("cold head %d: written %u copied %u erased %u WA %u%%",
+		cold_head, sfcb.stats.wr_bytes, sfcb.stats.cp_bytes,
+		sfcb.stats.flash_er_cnt, wa);
+#endif
+
+	/* validate after remount */
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	for (id = COLD_ID_START; id < COLD_ID_START + COLD_ID_CNT; id++) {
+		memset(data, (u8_t)id, sizeof(data));
+		rc = sfcb_read(&sfcb, id, buf, sizeof(buf));
+		zassert_true(rc == sizeof(buf), "Read failed [%d]", rc);
+		zassert_true(memcmp(data, buf, sizeof(buf)) == 0,
+			     "Wrong data for id %u", id);
+	}
+
+	for (id = 0; id < HOT_ID_CNT; id++) {
+		rc = sfcb_read(&sfcb, id, &value, sizeof(value));
+		zassert_true(rc == sizeof(value), "Read failed [%d]", rc);
+		zassert_true(value == HOT_WR_CNT - HOT_ID_CNT + id,
+			     "Wrong value for id %u [%u]", id, value);
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	sfcb.greedy = false;
+	sfcb.cold_head = false;
+	return wa;
+}
+
+void test_sfcb_cold_head(void)
+{
+	u32_t wa_single, wa_cold;
+
+	wa_single = cold_head_workload(false);
+	wa_cold = cold_head_workload(true);
+	zassert_true(wa_cold <= wa_single, "Cold head increases WA");
+}
+#else
+void test_sfcb_cold_head(void)
+{
+	ztest_test_skip();
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_COLD_HEAD) */
+
+#if IS_ENABLED(CONFIG_SFCB_GREEDY)
+#define GREEDY_COLD_CNT 32
+#define GREEDY_ID_CNT 32
+#define GREEDY_WR_CNT 4000
+
+/* Skewed workload: 7 out of 8 updates go to 4 ids */
+static u32_t greedy_workload(bool greedy, bool cold_head)
+{
+	int rc;
+	u8_t data[16], buf[16];
+	u32_t value, rnd = 1U, wa = 0;
+	u32_t exp[GREEDY_ID_CNT];
+	u16_t id;
+
+	(void)sfcb_unmount(&sfcb);
+	sfcb.cfg = &cfgmax8sector;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+
+	sfcb.compress = &compress_newest;
+	sfcb.greedy = greedy;
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	sfcb.cold_head = cold_head;
+#endif
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	for (id = GREEDY_ID_CNT; id < GREEDY_ID_CNT + GREEDY_COLD_CNT; id++) {
+		memset(data, (u8_t)id, sizeof(data));
+		rc = sfcb_write(&sfcb, id, data, sizeof(data));
+		zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+	}
+
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+	memset(&sfcb.stats, 0, sizeof(sfcb.stats));
+#endif
+
+	for (value = 0; value < GREEDY_WR_CNT; value++) {
+		rnd = rnd * 1103515245U + 12345U;
+		id = (rnd >> 16) % GREEDY_ID_CNT;
+		if ((rnd >> 8) & 0x7) {
+			id &= 0x3;
+		}
+		rc = sfcb_write(&sfcb, id, &value, sizeof(value));
+		zassert_true(rc == sizeof(value), "Write failed [%d]", rc);
+		exp[id] = value;
+	}
+
+#if IS_ENABLED(CONFIG_SFCB_STATS)
+	/* write amplification in percent */
+	wa = (100 * (sfcb.stats.wr_bytes + sfcb.stats.cp_bytes)) /
+	     sfcb.stats.wr_bytes;
+	LOG_INF("greedy %d cold head %d: written %u copied %u erased %u WA %u%%",
+		greedy, cold_head, sfcb.stats.wr_bytes, sfcb.stats.cp_bytes,
+		sfcb.stats.flash_er_cnt, wa);
+#endif
+
+	/* validate after remount */
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	for (id = 0; id < GREEDY_ID_CNT + GREEDY_COLD_CNT; id++) {
+		if (id < GREEDY_ID_CNT) {
+			rc = sfcb_read(&sfcb, id, &value, sizeof(value));
+			zassert_true(rc == sizeof(value), "Read failed [%d]", rc);
+			zassert_true(value == exp[id], "Wrong value for id %u",
+				     id);
+			continue;
+		}
+		memset(data, (u8_t)id, sizeof(data));
+		rc = sfcb_read(&sfcb, id, buf, sizeof(buf));
+		zassert_true(rc == sizeof(buf), "Read failed [%d]", rc);
+		zassert_true(memcmp(data, buf, sizeof(buf)) == 0,
+			     "Wrong data for id %u", id);
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	sfcb.greedy = false;
+#if IS_ENABLED(CONFIG_SFCB_COLD_HEAD)
+	sfcb.cold_head = false;
+#endif
+	return wa;
+}
+
+void test_sfcb_greedy(void)
+{
+	u32_t wa_strict, wa_greedy;
+
+	wa_strict = greedy_workload(false, false);
+	wa_greedy = greedy_workload(true, false);
+	zassert_true(wa_greedy <= wa_strict, "Greedy compress increases WA");
+	if (IS_ENABLED(CONFIG_SFCB_COLD_HEAD)) {
+		wa_greedy = greedy_workload(true, true);
+		zassert_true(wa_greedy <= wa_strict,
+			     "Greedy compress increases WA");
+	}
+}
+#else
+void test_sfcb_greedy(void)
+{
+	ztest_test_skip();
+}
+#endif /* IS_ENABLED(CONFIG_SFCB_GREEDY) */
+
+#if IS_ENABLED(CONFIG_SFCB_COMPRESS_INCREMENTAL) && IS_ENABLED(CONFIG_SFCB_STATS)
+/* Keep the item when there is no newer item with the same id */
+static int compress_loc_newest(sfcb_loc *loc)
+{
+	sfcb_loc loc_walk = *loc;
+	sfcb_ate *ate, *ate_walk;
+
+	ate = sfcb_get_ate(loc);
+	while (!sfcb_next_loc(&loc_walk)) {
+		ate_walk = sfcb_get_ate(&loc_walk);
+		if (ate_walk->id == ate->id) {
+			return 0;
+		}
+	}
+	return sfcb_copy_loc(loc);
+}
+
+static int compress_loc_fail(sfcb_loc *loc)
+{
+	return -EIO;
+}
+
+#define INC_COLD_ID_START 100
+#define INC_COLD_ID_CNT 24
+#define INC_COLD_LEN 16
+#define INC_HOT_ID_CNT 8
+#define INC_WR_CNT 3000
+#define INC_LARGE_ID_START 200
+#define INC_LARGE_ID_CNT 2
+#define INC_LARGE_LEN 64
+
+/*
+ * Worst case flash writes for a sfcb_write() of len bytes: data, tail and ate,
+ * the copies of one compress step (cp_len bytes maximum) and on a new sector
+ * the sector start, the compress sector marker and a directory.
+ */
+#if IS_ENABLED(CONFIG_SFCB_DIRECTORY)
+#define INC_DIR_WR_MAX (DIV_ROUND_UP(7 + 3 * CONFIG_SFCB_DIRECTORY_BUCKETS + \
+	4 * CONFIG_SFCB_DIRECTORY_MAX_ENTRIES, CONFIG_SFCB_WBS) + 2)
+#else
+#define INC_DIR_WR_MAX 0
+#endif
+#define INC_WR_MAX(len, cp_len) (DIV_ROUND_UP(len, CONFIG_SFCB_WBS) + 2 + \
+	CONFIG_SFCB_COMPRESS_STEP * (DIV_ROUND_UP(cp_len, CONFIG_SFCB_WBS) + 1) + \
+	2 + INC_DIR_WR_MAX)
+
+struct inc_max {
+	u32_t cp;
+	u32_t wr;
+	u32_t er;
+	u32_t rd;
+	u32_t again;
+};
+
+/* Write and retry on -EAGAIN, keep the maximum flash use of one call */
+static int inc_write(u16_t id, const void *data, size_t len,
+		     struct inc_max *max)
+{
+	int rc;
+	u32_t cp_cnt, wr_cnt, er_cnt, rd_cnt;
+
+	do {
+		cp_cnt = sfcb.stats.cp_cnt;
+		wr_cnt = sfcb.stats.flash_wr_cnt;
+		er_cnt = sfcb.stats.flash_er_cnt;
+		rd_cnt = sfcb.stats.flash_rd_cnt;
+		rc = sfcb_write(&sfcb, id, data, len);
+		max->cp = MAX(max->cp, sfcb.stats.cp_cnt - cp_cnt);
+		max->wr = MAX(max->wr, sfcb.stats.flash_wr_cnt - wr_cnt);
+		max->er = MAX(max->er, sfcb.stats.flash_er_cnt - er_cnt);
+		max->rd = MAX(max->rd, sfcb.stats.flash_rd_cnt - rd_cnt);
+		if (rc == -EAGAIN) {
+			max->again++;
+		}
+	} while (rc == -EAGAIN);
+
+	return rc;
+}
+
+void test_sfcb_incremental(void)
+{
+	int rc;
+	u8_t data[INC_COLD_LEN], buf[INC_COLD_LEN];
+	u32_t value;
+	struct inc_max max = {0};
+	u16_t id;
+	u8_t large[INC_LARGE_LEN];
+
+	(void)sfcb_unmount(&sfcb);
+	sfcb.cfg = &cfgmax8sector;
+	rc = sfcb_format(&sfcb);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+
+	sfcb.compress = NULL;
+	sfcb.compress_loc = &compress_loc_newest;
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	for (id = INC_COLD_ID_START; id < INC_COLD_ID_START + INC_COLD_ID_CNT;
+	     id++) {
+		memset(data, (u8_t)id, sizeof(data));
+		rc = sfcb_write(&sfcb, id, data, sizeof(data));
+		zassert_true(rc == sizeof(data), "Write failed [%d]", rc);
+	}
+
+	for (value = 0; value < INC_WR_CNT; value++) {
+		rc = inc_write(value % INC_HOT_ID_CNT, &value, sizeof(value),
+			       &max);
+		zassert_true(rc == sizeof(value), "Write failed [%d]", rc);
+	}
+
+	LOG_INF("incremental compress: per write max %u copies, %u writes, "
+		"%u erases, %u reads, %u retries", max.cp, max.wr, max.er,
+		max.rd, max.again);
+	zassert_true(max.cp <= CONFIG_SFCB_COMPRESS_STEP, "Too many copies");
+	zassert_true(max.er <= 1, "Too many erases");
+	zassert_true(max.wr <= INC_WR_MAX(sizeof(value), INC_COLD_LEN),
+		     "Too many writes");
+
+	/*
+	 * Large writes use up the free space faster than K items per write
+	 * copy the live data, they are retried but the bound still holds for
+	 * each call.
+	 */
+	memset(&max, 0, sizeof(max));
+	for (value = 0; value < INC_WR_CNT / 4; value++) {
+		memset(large, (u8_t)value, sizeof(large));
+		rc = inc_write(INC_LARGE_ID_START + value % INC_LARGE_ID_CNT,
+			       large, sizeof(large), &max);
+		zassert_true(rc == sizeof(large), "Write failed [%d]", rc);
+	}
+
+	LOG_INF("incremental compress: per large write max %u copies, "
+		"%u writes, %u erases, %u retries", max.cp, max.wr, max.er,
+		max.again);
+	zassert_true(max.cp <= CONFIG_SFCB_COMPRESS_STEP, "Too many copies");
+	zassert_true(max.er <= 1, "Too many erases");
+	zassert_true(max.wr <= INC_WR_MAX(sizeof(large), INC_LARGE_LEN),
+		     "Too many writes");
+
+	/* A failing compress fails the write, the compress is retried */
+	sfcb.compress_loc = &compress_loc_fail;
+	for (value = 0; value < INC_WR_CNT; value++) {
+		rc = sfcb_write(&sfcb, INC_LARGE_ID_START, large,
+				sizeof(large));
+		if ((rc != sizeof(large)) && (rc != -EAGAIN)) {
+			break;
+		}
+	}
+	zassert_true(rc == -EIO, "Compress failure not reported [%d]", rc);
+	sfcb.compress_loc = &compress_loc_newest;
+	for (value = 0; value < INC_WR_CNT / 4; value++) {
+		rc = inc_write(INC_LARGE_ID_START, large, sizeof(large), &max);
+		zassert_true(rc == sizeof(large), "Write failed [%d]", rc);
+	}
+
+	/* validate after remount */
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	rc = sfcb_mount(&sfcb);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	for (id = INC_COLD_ID_START; id < INC_COLD_ID_START + INC_COLD_ID_CNT;
+	     id++) {
+		memset(data, (u8_t)id, sizeof(data));
+		rc = sfcb_read(&sfcb, id, buf, sizeof(buf));
+		zassert_true(rc == sizeof(buf), "Read failed [%d]", rc);
+		zassert_true(memcmp(data, buf, sizeof(buf)) == 0,
+			     "Wrong data for id %u", id);
+	}
+
+	for (id = 0; id < INC_HOT_ID_CNT; id++) {
+		rc = sfcb_read(&sfcb, id, &value, sizeof(value));
+		zassert_true(rc == sizeof(value), "Read failed [%d]", rc);
+		zassert_true(value == INC_WR_CNT - INC_HOT_ID_CNT + id,
+			     "Wrong value for id %u [%u]", id, value);
+	}
+
+	rc = sfcb_unmount(&sfcb);
+	zassert_true(rc == 0, "Unmount failed [%d]", rc);
+	sfcb.compress_loc = NULL;
+}
+#else
+void test_sfcb_incremental(void)
+{
+	ztest_test_skip();
+}
+#endif
+
+extern void test_sfcb_powercut(void);
+
 void test_main(void)
 {
 	ztest_test_suite(test_sfcb,
 			 ztest_unit_test(test_sfcb_mount),
+			 ztest_unit_test(test_sfcb_format),
 			 ztest_unit_test(test_sfcb_loc),
 			 ztest_unit_test(test_sfcb_loc_first),
 			 ztest_unit_test(test_sfcb_loc_walk),
 			 ztest_unit_test(test_sfcb_readwritelowlevel),
 			 ztest_unit_test(test_sfcb_readwritehighlevel),
-			 ztest_unit_test(test_sfcb_compress)
+			 ztest_unit_test(test_sfcb_write_if_changed),
+			 ztest_unit_test(test_sfcb_find_loc),
+			 ztest_unit_test(test_sfcb_mount_ro),
+			 ztest_unit_test(test_sfcb_read_many),
+			 ztest_unit_test(test_sfcb_directory),
+			 ztest_unit_test(test_sfcb_directory_fallback),
+			 ztest_unit_test(test_sfcb_seq),
+			 ztest_unit_test(test_sfcb_log),
+			 ztest_unit_test(test_sfcb_compress),
+			 ztest_unit_test(test_sfcb_cold_head),
+			 ztest_unit_test(test_sfcb_greedy),
+			 ztest_unit_test(test_sfcb_incremental),
+			 ztest_unit_test(test_sfcb_powercut)
 			);
 
 	ztest_run_test_suite(test_sfcb);
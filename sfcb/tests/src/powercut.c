@@ -0,0 +1,319 @@
+/*
+ * Copyright (c) 2019 Laczen
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/*
+ * Power cut test: a flash driver that wraps the storage flash device and
+ * stops working at a selected program or erase operation. A program that
+ * is cut only writes the first half of its data (rounded down to the write
+ * block size), an erase that is cut is not done. After the cut all flash
+ * operations fail until the cut is cleared, the file system is then mounted
+ * again (this is the recovery) and the data is verified.
+ */
+#include <sfcb.h>
+#include <drivers/flash.h>
+#include <ztest.h>
+#include <string.h>
+#include <logging/log.h>
+LOG_MODULE_REGISTER(powercut);
+
+#define PC_FLASH_DEV "FLASH_PWRCUT"
+#define PC_ID_CNT 8
+#define PC_COLD_CNT 8
+#define PC_WR_CNT 1200
+#define PC_RANDOM_CUT_CNT 64
+#define PC_ROLLOVER_WINDOW 48
+
+struct pc_flash_data {
+	struct device *flash;
+	u32_t ops;	/* program and erase operations */
+	u32_t cut_at;	/* operation that is cut, 0 is no cut */
+	bool cut;
+	u32_t rd_cnt;
+	u32_t wr_cnt;
+	u32_t er_cnt;
+	u32_t er_ops[64];	/* operation number of erases */
+	u32_t er_ops_cnt;
+};
+
+static struct pc_flash_data pc_data;
+
+static const struct flash_driver_api *pc_api(void)
+{
+	return (const struct flash_driver_api *)pc_data.flash->driver_api;
+}
+
+/* Returns true when this operation is cut */
+static bool pc_flash_cut(void)
+{
+	pc_data.ops++;
+	if ((pc_data.cut_at) && (pc_data.ops == pc_data.cut_at)) {
+		pc_data.cut = true;
+		return true;
+	}
+	return false;
+}
+
+static int pc_flash_read(struct device *dev, off_t offset, void *data,
+			 size_t len)
+{
+	if (pc_data.cut) {
+		return -EIO;
+	}
+	pc_data.rd_cnt++;
+	return flash_read(pc_data.flash, offset, data, len);
+}
+
+static int pc_flash_write(struct device *dev, off_t offset, const void *data,
+			  size_t len)
+{
+	size_t wbs;
+
+	if (pc_data.cut) {
+		return -EIO;
+	}
+
+	pc_data.wr_cnt++;
+	if (pc_flash_cut()) {
+		wbs = pc_api()->write_block_size;
+		len = ((len / 2) / wbs) * wbs;
+		if (len) {
+			(void)flash_write(pc_data.flash, offset, data, len);
+		}
+		return -EIO;
+	}
+
+	return flash_write(pc_data.flash, offset, data, len);
+}
+
+static int pc_flash_erase(struct device *dev, off_t offset, size_t size)
+{
+	if (pc_data.cut) {
+		return -EIO;
+	}
+
+	pc_data.er_cnt++;
+	if (pc_flash_cut()) {
+		return -EIO;
+	}
+
+	if (pc_data.er_ops_cnt < ARRAY_SIZE(pc_data.er_ops)) {
+		pc_data.er_ops[pc_data.er_ops_cnt++] = pc_data.ops;
+	}
+	return flash_erase(pc_data.flash, offset, size);
+}
+
+static int pc_flash_write_protection(struct device *dev, bool enable)
+{
+	if (pc_data.cut) {
+		return -EIO;
+	}
+	return flash_write_protection_set(pc_data.flash, enable);
+}
+
+#if defined(CONFIG_FLASH_PAGE_LAYOUT)
+static void pc_flash_page_layout(struct device *dev,
+				 const struct flash_pages_layout **layout,
+				 size_t *layout_size)
+{
+	pc_api()->page_layout(pc_data.flash, layout, layout_size);
+}
+#endif
+
+static const struct flash_driver_api pc_flash_api = {
+	.read = pc_flash_read,
+	.write = pc_flash_write,
+	.erase = pc_flash_erase,
+	.write_protection = pc_flash_write_protection,
+#if defined(CONFIG_FLASH_PAGE_LAYOUT)
+	.page_layout = pc_flash_page_layout,
+#endif
+	.write_block_size = 1,
+};
+
+static int pc_flash_init(struct device *dev)
+{
+	pc_data.flash = device_get_binding(DT_FLASH_AREA_STORAGE_DEV);
+	if (!pc_data.flash) {
+		return -ENODEV;
+	}
+	return 0;
+}
+
+DEVICE_AND_API_INIT(pc_flash, PC_FLASH_DEV, pc_flash_init, &pc_data, NULL,
+		    APPLICATION, CONFIG_APPLICATION_INIT_PRIORITY,
+		    &pc_flash_api);
+
+static void pc_flash_reset(u32_t cut_at)
+{
+	pc_data.ops = 0U;
+	pc_data.cut_at = cut_at;
+	pc_data.cut = false;
+	pc_data.rd_cnt = 0U;
+	pc_data.wr_cnt = 0U;
+	pc_data.er_cnt = 0U;
+}
+
+/* At most 8 sectors, the storage partition can be smaller (nrf51: 6) */
+static const sfcb_fs_cfg pc_cfg = {
+	.offset = DT_FLASH_AREA_STORAGE_OFFSET,
+	.size = MIN(8 * DT_FLASH_ERASE_BLOCK_SIZE, DT_FLASH_AREA_STORAGE_SIZE),
+	.dev_name = PC_FLASH_DEV,
+};
+
+static sfcb_fs pc_fs = {
+	.cfg = &pc_cfg,
+};
+
+extern int compress_newest(sfcb_fs *fs);
+
+/* Worst case recovery found, each item is a maximum on its own */
+struct pc_recovery {
+	u32_t us;
+	u32_t rd_cnt;
+	u32_t wr_cnt;
+	u32_t er_cnt;
+};
+
+static struct pc_recovery pc_worst;
+
+/* Id of the n-th write: first the cold ids are written once, they are
+ * copied by every compress, then the hot ids are updated.
+ */
+static u16_t pc_id(u32_t n)
+{
+	if (n <= PC_COLD_CNT) {
+		return PC_ID_CNT + n - 1;
+	}
+	return n % PC_ID_CNT;
+}
+
+/* Write PC_WR_CNT values, returns the number of successful writes */
+static u32_t pc_workload(u32_t *committed, u32_t *inflight)
+{
+	u32_t value, data[4];
+	ssize_t rc;
+
+	for (value = 1U; value <= PC_WR_CNT; value++) {
+		data[0] = data[1] = data[2] = data[3] = value;
+		*inflight = value;
+		rc = sfcb_write(&pc_fs, pc_id(value), data, sizeof(data));
+		if (rc != sizeof(data)) {
+			break;
+		}
+		committed[pc_id(value)] = value;
+	}
+
+	return value - 1;
+}
+
+static void pc_run(u32_t cut_at)
+{
+	int rc;
+	u32_t committed[PC_ID_CNT + PC_COLD_CNT], inflight, data[4], start, us;
+	u16_t id;
+
+	(void)sfcb_unmount(&pc_fs);
+	pc_flash_reset(0U);
+	rc = sfcb_format(&pc_fs);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+
+	pc_fs.compress = &compress_newest;
+	rc = sfcb_mount(&pc_fs);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+
+	memset(committed, 0, sizeof(committed));
+	pc_flash_reset(cut_at);
+	(void)pc_workload(committed, &inflight);
+	(void)sfcb_unmount(&pc_fs);
+
+	/* recovery */
+	pc_flash_reset(0U);
+	start = k_cycle_get_32();
+	rc = sfcb_mount(&pc_fs);
+	us = (u32_t)(SYS_CLOCK_HW_CYCLES_TO_NS64(k_cycle_get_32() - start) /
+		     1000U);
+	zassert_true(rc == 0, "Mount after cut at %u failed [%d]", cut_at, rc);
+
+	pc_worst.rd_cnt = MAX(pc_worst.rd_cnt, pc_data.rd_cnt);
+	pc_worst.wr_cnt = MAX(pc_worst.wr_cnt, pc_data.wr_cnt);
+	pc_worst.er_cnt = MAX(pc_worst.er_cnt, pc_data.er_cnt);
+	pc_worst.us = MAX(pc_worst.us, us);
+
+	/* each id holds its last committed value, or the value in flight */
+	for (id = 0U; id < PC_ID_CNT + PC_COLD_CNT; id++) {
+		rc = sfcb_read(&pc_fs, id, data, sizeof(data));
+		if ((rc == -ENOENT) && (!committed[id])) {
+			continue;
+		}
+		zassert_true(rc == sizeof(data),
+			     "Read after cut at %u failed [%d]",
+			     cut_at, rc);
+		zassert_true((data[0] == data[3]) &&
+			     ((data[0] == committed[id]) ||
+			      ((id == pc_id(inflight)) &&
+			       (data[0] == inflight))),
+			     "Wrong data for id %u after cut at %u", id, cut_at);
+	}
+
+	/* the file system is usable after recovery */
+	data[0] = data[1] = data[2] = data[3] = 0xdeadbeef;
+	rc = sfcb_write(&pc_fs, 0, data, sizeof(data));
+	zassert_true(rc == sizeof(data), "Write after cut at %u failed [%d]",
+		     cut_at, rc);
+	memset(data, 0, sizeof(data));
+	rc = sfcb_read(&pc_fs, 0, data, sizeof(data));
+	zassert_true((rc == sizeof(data)) && (data[3] == 0xdeadbeef),
+		     "Read back after cut at %u failed", cut_at);
+
+	(void)sfcb_unmount(&pc_fs);
+}
+
+void test_sfcb_powercut(void)
+{
+	u32_t ops, er_ops[ARRAY_SIZE(pc_data.er_ops)], er_ops_cnt;
+	u32_t committed[PC_ID_CNT + PC_COLD_CNT], inflight, rnd = 1U;
+	u32_t i, cut_at, sector_cnt;
+	int rc;
+
+	/* dry run to find the operation count and the erases */
+	(void)sfcb_unmount(&pc_fs);
+	pc_flash_reset(0U);
+	rc = sfcb_format(&pc_fs);
+	zassert_true(rc == 0, "Format failed [%d]", rc);
+	pc_fs.compress = &compress_newest;
+	rc = sfcb_mount(&pc_fs);
+	zassert_true(rc == 0, "Mount failed [%d]", rc);
+	sector_cnt = pc_fs.sector_cnt;
+	pc_flash_reset(0U);
+	pc_data.er_ops_cnt = 0U;
+	memset(committed, 0, sizeof(committed));
+	zassert_true(pc_workload(committed, &inflight) == PC_WR_CNT,
+		     "Workload failed");
+	ops = pc_data.ops;
+	er_ops_cnt = pc_data.er_ops_cnt;
+	memcpy(er_ops, pc_data.er_ops, sizeof(er_ops));
+	(void)sfcb_unmount(&pc_fs);
+	zassert_true(er_ops_cnt > sector_cnt, "Workload does not wrap");
+
+	memset(&pc_worst, 0, sizeof(pc_worst));
+
+	/* every operation of the first rollover with a compress */
+	for (i = 0U; i < PC_ROLLOVER_WINDOW; i++) {
+		pc_run(er_ops[sector_cnt] + i);
+	}
+
+	/* random operations during the workload */
+	for (i = 0U; i < PC_RANDOM_CUT_CNT; i++) {
+		rnd = rnd * 1103515245U + 12345U;
+		cut_at = 1U + (rnd >> 8) % ops;
+		pc_run(cut_at);
+	}
+
+	LOG_INF("power cut: %u cuts in %u ops, worst recovery %u us, "
+		"%u reads, %u writes, %u erases",
+		PC_ROLLOVER_WINDOW + PC_RANDOM_CUT_CNT, ops, pc_worst.us,
+		pc_worst.rd_cnt, pc_worst.wr_cnt, pc_worst.er_cnt);
+}
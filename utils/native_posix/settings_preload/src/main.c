@@ -15,9 +15,12 @@
 #include <sys/mman.h>
 #include <fcntl.h>
 #include <errno.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <settings/settings.h>
+#include <storage/flash_map.h>
+#include <sys/base64.h>
 
 #include "cmdline.h"
 #include "soc.h"
@@ -26,10 +29,14 @@
 #include <logging/log.h>
 LOG_MODULE_REGISTER(main, CONFIG_LOG_DEFAULT_LEVEL);
 
-#define MAX_BYTE_ARRAY_SIZE 256
+#define MAX_BYTE_ARRAY_SIZE 1024
+#define MAX_LINE_SIZE (2 * MAX_BYTE_ARRAY_SIZE + SETTINGS_MAX_NAME_LEN + 16)
 
 static const char *preload_name;
 static const char *preload_value;
+static const char *preload_manifest;
+static const char *preload_hex;
+static bool preload_batch;
 
 static struct hex_value {
 	u8_t value[MAX_BYTE_ARRAY_SIZE];
@@ -57,6 +64,32 @@ static void preload_native_posix_options(void)
 		  .dest = (void *)&preload_value,
 		  .call_when_found = NULL,
 		  .descript = "Value of the preload parameter" },
+		{ .manual = false,
+		  .is_mandatory = false,
+		  .is_switch = false,
+		  .option = "manifest",
+		  .name = "file",
+		  .type = 's',
+		  .dest = (void *)&preload_manifest,
+		  .call_when_found = NULL,
+		  .descript = "File with name=value lines to preload" },
+		{ .manual = false,
+		  .is_mandatory = false,
+		  .is_switch = true,
+		  .option = "batch",
+		  .type = 'b',
+		  .dest = (void *)&preload_batch,
+		  .call_when_found = NULL,
+		  .descript = "Save the manifest in one settings_save()" },
+		{ .manual = false,
+		  .is_mandatory = false,
+		  .is_switch = false,
+		  .option = "hex",
+		  .name = "file",
+		  .type = 's',
+		  .dest = (void *)&preload_hex,
+		  .call_when_found = NULL,
+		  .descript = "Write the storage partition as intel hex file" },
 		ARG_TABLE_ENDMARKER
 	};
 
@@ -100,6 +133,231 @@ int str2bytearray(const char *string, struct hex_value *hex_value)
 	return 0;
 }
 
+/* Read the file at path as value */
+static int file2bytearray(const char *path, struct hex_value *hex_value)
+{
+	FILE *fp;
+	size_t len;
+
+	fp = fopen(path, "rb");
+	if (!fp) {
+		LOG_ERR("Unable to open %s", path);
+		return -ENOENT;
+	}
+
+	len = fread(hex_value->value, 1, sizeof(hex_value->value), fp);
+	if ((ferror(fp)) || ((len == sizeof(hex_value->value)) &&
+			     (fgetc(fp) != EOF))) {
+		/* read error or file is to big */
+		LOG_ERR("Malformed Value");
+		len = 0;
+	}
+	(void)fclose(fp);
+
+	hex_value->len = len;
+	return len ? 0 : -EINVAL;
+}
+
+/*
+ * Convert a manifest value: 0x<hex>, base64:<data>, @<file>, "<string>" or
+ * <string>. Strings are stored without the quotes and without a terminating
+ * '\0', as with -pvalue.
+ */
+static int manifest2bytearray(char *value, struct hex_value *hex_value)
+{
+	size_t len = strlen(value);
+
+	if (!strncmp(value, "0x", 2)) {
+		return str2bytearray(value + 2, hex_value);
+	}
+
+	if (!strncmp(value, "base64:", 7)) {
+		if (base64_decode(hex_value->value, sizeof(hex_value->value),
+				  &hex_value->len, (const u8_t *)value + 7,
+				  len - 7)) {
+			LOG_ERR("Malformed Value");
+			return -EINVAL;
+		}
+		return 0;
+	}
+
+	if (value[0] == '@') {
+		return file2bytearray(value + 1, hex_value);
+	}
+
+	if ((len >= 2) && (value[0] == '"') && (value[len - 1] == '"')) {
+		value++;
+		len -= 2;
+	}
+
+	if (len > sizeof(hex_value->value)) {
+		LOG_ERR("Malformed Value");
+		return -EINVAL;
+	}
+
+	memcpy(hex_value->value, value, len);
+	hex_value->len = len;
+	return 0;
+}
+
+/* Save each name=value line of the manifest with save, empty lines and lines
+ * that start with # are skipped.
+ */
+static int preload_manifest_save(int (*save)(const char *name,
+					     const void *value, size_t len))
+{
+	static char line[MAX_LINE_SIZE];
+	char *name, *value, *end;
+	u32_t lineno = 0U, cnt = 0U;
+	FILE *fp;
+	int rc = 0;
+
+	fp = fopen(preload_manifest, "r");
+	if (!fp) {
+		LOG_ERR("Unable to open %s", preload_manifest);
+		return -ENOENT;
+	}
+
+	while (fgets(line, sizeof(line), fp)) {
+		lineno++;
+		end = line + strlen(line);
+		if ((end[-1] != '\n') && (!feof(fp))) {
+			/* line is to long */
+			LOG_ERR("Malformed line %u", lineno);
+			rc = -EINVAL;
+			break;
+		}
+
+		while ((end > line) && ((end[-1] == '\n') || (end[-1] == '\r') ||
+					 (end[-1] == ' '))) {
+			*--end = '\0';
+		}
+
+		name = line;
+		while (*name == ' ') {
+			name++;
+		}
+
+		if ((*name == '\0') || (*name == '#')) {
+			continue;
+		}
+
+		value = strchr(name, '=');
+		if ((!value) || (value == name)) {
+			LOG_ERR("Malformed line %u", lineno);
+			rc = -EINVAL;
+			break;
+		}
+		end = value;
+		*value++ = '\0';
+		while ((end > name) && (end[-1] == ' ')) {
+			*--end = '\0';
+		}
+
+		while (*value == ' ') {
+			value++;
+		}
+
+		rc = manifest2bytearray(value, &hex_value);
+		if (rc) {
+			LOG_ERR("Malformed line %u", lineno);
+			break;
+		}
+
+		rc = save(name, hex_value.value, hex_value.len);
+		if (rc) {
+			LOG_ERR("Failed to save %s", name);
+			break;
+		}
+		cnt++;
+	}
+
+	(void)fclose(fp);
+	if (!rc) {
+		LOG_INF("Stored %u settings from %s", cnt, preload_manifest);
+	}
+	return rc;
+}
+
+/* With -batch the manifest is saved from the export handler, settings_save()
+ * calls it between the start and the end of one save to the backend.
+ */
+static int preload_manifest_export(int (*export_func)(const char *name,
+						      const void *val,
+						      size_t val_len))
+{
+	if ((!preload_manifest) || (!preload_batch)) {
+		return 0;
+	}
+
+	return preload_manifest_save(export_func);
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(preload, "preload_manifest", NULL, NULL, NULL,
+			       preload_manifest_export);
+
+static void ihex_record(FILE *fp, u16_t addr, u8_t type, const u8_t *data,
+			u8_t len)
+{
+	u8_t i, sum;
+
+	sum = len + (addr >> 8) + (addr & 0xff) + type;
+	fprintf(fp, ":%02X%04X%02X", len, addr, type);
+	for (i = 0U; i < len; i++) {
+		fprintf(fp, "%02X", data[i]);
+		sum += data[i];
+	}
+	fprintf(fp, "%02X\n", (u8_t)(0x100 - sum));
+}
+
+/* Write the storage partition as intel hex at the partition offset */
+static int preload_hex_write(const char *path)
+{
+	const struct flash_area *fa;
+	u8_t buf[16], upper[2];
+	u32_t off, addr, base = UINT32_MAX;
+	size_t len;
+	FILE *fp;
+	int rc;
+
+	rc = flash_area_open(DT_FLASH_AREA_STORAGE_ID, &fa);
+	if (rc) {
+		return rc;
+	}
+
+	fp = fopen(path, "w");
+	if (!fp) {
+		LOG_ERR("Unable to open %s", path);
+		flash_area_close(fa);
+		return -ENOENT;
+	}
+
+	for (off = 0U; off < fa->fa_size; off += len) {
+		len = MIN(sizeof(buf), fa->fa_size - off);
+		rc = flash_area_read(fa, off, buf, len);
+		if (rc) {
+			break;
+		}
+
+		addr = fa->fa_off + off;
+		if ((addr >> 16) != base) {
+			base = addr >> 16;
+			upper[0] = (u8_t)(base >> 8);
+			upper[1] = (u8_t)base;
+			ihex_record(fp, 0U, 4U, upper, sizeof(upper));
+		}
+		ihex_record(fp, (u16_t)addr, 0U, buf, (u8_t)len);
+	}
+	ihex_record(fp, 0U, 1U, NULL, 0U);
+
+	(void)fclose(fp);
+	if (!rc) {
+		LOG_INF("Written %s at 0x%x", path, (u32_t)fa->fa_off);
+	}
+	flash_area_close(fa);
+	return rc;
+}
+
 void main(void)
 {
 	int rc;
@@ -108,25 +366,42 @@ void main(void)
 		LOG_ERR("Failed to initialize settings subsystem");
 	}
 
-	if (!strncmp(preload_value, "0x", 2)) {
-		rc = str2bytearray(preload_value+2, &hex_value);
+	if (preload_manifest) {
+		if (preload_batch) {
+			rc = settings_save();
+		} else {
+			rc = preload_manifest_save(settings_save_one);
+		}
 		if (rc) {
 			posix_exit(rc);
 		}
-		rc = settings_save_one(preload_name, hex_value.value,
-				       hex_value.len);
+	}
+
+	if ((preload_name) && (preload_value)) {
+		if (!strncmp(preload_value, "0x", 2)) {
+			rc = str2bytearray(preload_value+2, &hex_value);
+			if (rc) {
+				posix_exit(rc);
+			}
+			rc = settings_save_one(preload_name, hex_value.value,
+					       hex_value.len);
+		} else {
+			rc = settings_save_one(preload_name, preload_value,
+					       strlen(preload_value));
+		}
 		if (rc) {
 			LOG_ERR("Failed to save");
 			posix_exit(rc);
 		}
-	} else {
-		rc = settings_save_one(preload_name, preload_value,
-				       strlen(preload_value));
+		LOG_INF("Stored %s to %s", preload_value, preload_name);
+	}
+
+	if (preload_hex) {
+		rc = preload_hex_write(preload_hex);
 		if (rc) {
-			LOG_ERR("Failed to save");
+			LOG_ERR("Failed to write hex");
 			posix_exit(rc);
 		}
 	}
-	LOG_INF("Stored %s to %s", preload_value, preload_name);
 	posix_exit(0);
 }
@@ -10,6 +10,7 @@
 
 #include <zb8/zb8_flash.h>
 #include <zb8/zb8_crypto.h>
+#include <tinycrypt/sha256.h>
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(test_zb_crypto);
@@ -46,6 +47,91 @@ void test_zb_hash(void)
 	zassert_true(err == 0, "Hash differs");
 }
 
+#define BENCH_HASH_SIZE 0x4000
+
+/* Hash as done before the work buffer: one read per HASH_BYTES */
+static int bench_hash_small(u8_t *hash, struct zb_slt_info *info, u32_t off,
+			    size_t len)
+{
+	struct tc_sha256_state_struct s;
+	u8_t buf[HASH_BYTES];
+	size_t buf_len;
+
+	(void)tc_sha256_init(&s);
+	while (len) {
+		buf_len = MIN(HASH_BYTES, len);
+		if (zb_read(info, off, buf, buf_len)) {
+			return -EIO;
+		}
+		(void)tc_sha256_update(&s, buf, buf_len);
+		off += buf_len;
+		len -= buf_len;
+	}
+	(void)tc_sha256_final(hash, &s);
+	return 0;
+}
+
+static u32_t bench_kbps(size_t len, u32_t cycles)
+{
+	u64_t us = SYS_CLOCK_HW_CYCLES_TO_NS64(cycles) / 1000U;
+
+	return (u32_t)((us) ? ((u64_t)len * 1000000U / 1024U / us) : 0U);
+}
+
+/**
+ * @brief Benchmark the hash calculation with HASH_BYTES and
+ * CONFIG_ZB_EIGHT_WORK_BUF_SIZE reads
+ */
+void test_zb_hash_bench(void)
+{
+	int err, cnt;
+	struct zb_slt_info info;
+	u8_t hash[HASH_BYTES], hash_small[HASH_BYTES], buf[256];
+	u32_t start, cyc_small, cyc, off, len;
+
+	cnt = zb_slt_area_cnt();
+	zassert_false(cnt == 0,  "Unable to get slotarea count: [cnt %d]", cnt);
+
+	err = zb_slt_open(&info, cnt - 1, RUN);
+	zassert_true(err == 0,  "Unable to get info: [err %d]", err);
+
+	len = MIN(info.size, BENCH_HASH_SIZE);
+	err = zb_erase(&info, 0, info.size);
+	zassert_true(err == 0,  "Unable to erase image 0 area: [err %d]", err);
+
+	for (off = 0; off < len; off += sizeof(buf)) {
+		for (cnt = 0; cnt < sizeof(buf); cnt++) {
+			buf[cnt] = (u8_t)(off / 7 + cnt);
+		}
+		err = zb_write(&info, off, buf, MIN(sizeof(buf), len - off));
+		zassert_true(err == 0,  "Unable to write data: [err %d]", err);
+	}
+
+	start = k_cycle_get_32();
+	err = bench_hash_small(hash_small, &info, 0, len);
+	cyc_small = k_cycle_get_32() - start;
+	zassert_true(err == 0, "Hash calculation failed: [err %d]", err);
+
+	start = k_cycle_get_32();
+	err = zb_hash(hash, &info, 0, len);
+	cyc = k_cycle_get_32() - start;
+	zassert_true(err == 0, "Hash calculation failed: [err %d]", err);
+
+	err = memcmp(hash, hash_small, HASH_BYTES);
+	zassert_true(err == 0, "Hash differs");
+
+	/* unaligned start */
+	(void)bench_hash_small(hash_small, &info, 3, len - 3);
+	err = zb_hash(hash, &info, 3, len - 3);
+	zassert_true(err == 0, "Hash calculation failed: [err %d]", err);
+	err = memcmp(hash, hash_small, HASH_BYTES);
+	zassert_true(err == 0, "Hash differs");
+
+	TC_PRINT("hash %u bytes: %u byte reads %u KiB/s, %u byte reads "
+		 "%u KiB/s\n", len, HASH_BYTES, bench_kbps(len, cyc_small),
+		 CONFIG_ZB_EIGHT_WORK_BUF_SIZE, bench_kbps(len, cyc));
+}
+
 extern u8_t test_signature[];
 
 /**
@@ -138,12 +224,135 @@ void test_zb_aes_dec(void)
 
 }
 
+/**
+ * @brief Test the aes ctr counter seek against a sequential aes ctr
+ */
+void test_zb_aes_ctr_seek(void)
+{
+	int err;
+	struct zb_aes_ctr ctx = {0};
+	u8_t ctr[AES_BLOCK_SIZE];
+	u8_t nonce[AES_BLOCK_SIZE];
+	u8_t seq[4 * AES_BLOCK_SIZE];
+	u8_t seek[2 * AES_BLOCK_SIZE];
+
+	/* carry over the counter bytes */
+	memset(nonce, 0, sizeof(nonce));
+	nonce[14] = 0xff;
+	nonce[15] = 0xfe;
+	memcpy(ctr, nonce, sizeof(ctr));
+
+	memset(seq, 0, sizeof(seq));
+	err = zb_aes_ctr_mode(seq, sizeof(seq), ctr, ec256_boot_pri_key);
+	zassert_true(err == 0,  "AES CTR returned [err %d]", err);
+
+	err = zb_aes_ctr_init(&ctx, ec256_boot_pri_key, nonce);
+	zassert_true(err == 0,  "AES CTR init returned [err %d]", err);
+
+	zb_aes_ctr_seek(&ctx, 2);
+	memset(seek, 0, sizeof(seek));
+	err = zb_aes_ctr_crypt(&ctx, seek, sizeof(seek));
+	zassert_true(err == 0,  "AES CTR returned [err %d]", err);
+	err = memcmp(seek, &seq[2 * AES_BLOCK_SIZE], sizeof(seek));
+	zassert_true(err == 0,  "AES CTR seek wrong keystream");
+	err = memcmp(ctx.ctr, ctr, sizeof(ctr));
+	zassert_true(err == 0,  "AES CTR seek wrong CTR value");
+
+	/* unaligned buffer and partial block */
+	zb_aes_ctr_seek(&ctx, 1);
+	memset(seek, 0, sizeof(seek));
+	err = zb_aes_ctr_crypt(&ctx, &seek[1], AES_BLOCK_SIZE + 3);
+	zassert_true(err == 0,  "AES CTR returned [err %d]", err);
+	err = memcmp(&seek[1], &seq[AES_BLOCK_SIZE], AES_BLOCK_SIZE + 3);
+	zassert_true(err == 0,  "AES CTR seek wrong keystream");
+}
+
+#define BENCH_AES_SECTOR 0x1000
+#define BENCH_AES_SECTORS 16
+
+static u8_t bench_aes_old[1024];
+static u8_t bench_aes_new[1024];
+
+/**
+ * @brief Benchmark the sector decryption of UPG2RUN/MOV2UPG: per sector
+ * counter stepping and key expansion against the kept aes ctr state
+ */
+void test_zb_aes_ctr_bench(void)
+{
+	int err = 0, i, j;
+	struct zb_aes_ctr ctx = {0};
+	u8_t ctr[AES_BLOCK_SIZE];
+	u8_t nonce[AES_BLOCK_SIZE];
+	u32_t start, cyc_old = 0, cyc_new = 0, sec, off;
+
+	memset(nonce, 0, sizeof(nonce));
+	nonce[15] = 0xf0;
+
+	for (sec = 0; sec < BENCH_AES_SECTORS; sec++) {
+		/* step the counter from the image start to the sector */
+		start = k_cycle_get_32();
+		memcpy(ctr, nonce, sizeof(ctr));
+		for (j = 0; j < sec * BENCH_AES_SECTOR / AES_BLOCK_SIZE; j++) {
+			for (i = AES_BLOCK_SIZE; i > 0; --i) {
+				if (++ctr[i - 1] != 0) {
+					break;
+				}
+			}
+		}
+		cyc_old += k_cycle_get_32() - start;
+
+		/* keep the key schedule, seek the counter */
+		start = k_cycle_get_32();
+		err = zb_aes_ctr_init(&ctx, ec256_boot_pri_key, nonce);
+		zb_aes_ctr_seek(&ctx, sec * BENCH_AES_SECTOR / AES_BLOCK_SIZE);
+		cyc_new += k_cycle_get_32() - start;
+		zassert_true(err == 0,  "AES CTR init returned [err %d]", err);
+
+		for (off = 0; off < BENCH_AES_SECTOR;
+		     off += sizeof(bench_aes_old)) {
+			for (j = 0; j < sizeof(bench_aes_old); j++) {
+				bench_aes_old[j] = (u8_t)(sec + off / 7 + j);
+			}
+			memcpy(bench_aes_new, bench_aes_old,
+			       sizeof(bench_aes_new));
+
+			/* key expansion on every buffer */
+			start = k_cycle_get_32();
+			err = zb_aes_ctr_mode(bench_aes_old,
+					      sizeof(bench_aes_old), ctr,
+					      ec256_boot_pri_key);
+			cyc_old += k_cycle_get_32() - start;
+			zassert_true(err == 0,  "AES CTR returned [err %d]",
+				     err);
+
+			start = k_cycle_get_32();
+			err = zb_aes_ctr_crypt(&ctx, bench_aes_new,
+					       sizeof(bench_aes_new));
+			cyc_new += k_cycle_get_32() - start;
+			zassert_true(err == 0,  "AES CTR returned [err %d]",
+				     err);
+
+			err = memcmp(bench_aes_old, bench_aes_new,
+				     sizeof(bench_aes_old));
+			zassert_true(err == 0,  "AES CTR output differs");
+		}
+	}
+
+	TC_PRINT("aes ctr %u bytes: stepped counter %u KiB/s, kept state "
+		 "%u KiB/s\n", BENCH_AES_SECTOR * BENCH_AES_SECTORS,
+		 bench_kbps(BENCH_AES_SECTOR * BENCH_AES_SECTORS, cyc_old),
+		 bench_kbps(BENCH_AES_SECTOR * BENCH_AES_SECTORS, cyc_new));
+}
+
 void test_zb_crypto(void)
 {
 	ztest_test_suite(test_zb_crypto,
 			 ztest_unit_test(test_zb_aes_enc),
 			 ztest_unit_test(test_zb_aes_dec),
+			 ztest_unit_test(test_zb_aes_ctr_seek),
+			 ztest_unit_test(test_zb_aes_ctr_bench),
 			 ztest_unit_test(test_zb_hash),
+			 ztest_unit_test(test_zb_hash_bench),
 			 ztest_unit_test(test_zb_sign_verify),
 			 ztest_unit_test(test_zb_get_encr_key)
 	);
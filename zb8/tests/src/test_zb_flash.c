@@ -9,6 +9,8 @@
 #include <ztest.h>
 
 #include <zb8/zb8_flash.h>
+#include <zb8/zb8_crc.h>
+#include <sys/crc.h>
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(test_zb_flash);
@@ -168,13 +170,81 @@ void test_zb_cmd(void)
 	zassert_true(err == -ENOSPC, "To many cmd writes possible");
 }
 
+#define BENCH_CRC32_SIZE 0x4000
+
+static u32_t bench_us(u32_t cycles)
+{
+	return (u32_t)(SYS_CLOCK_HW_CYCLES_TO_NS64(cycles) / 1000U);
+}
+
+/**
+ * @brief Test and benchmark the image crc32: bitwise crc32 with 32 byte
+ * reads versus zb_crc32_update() with ZB_CRC32_BUF_SIZE reads
+ */
+void test_zb_crc32(void)
+{
+	int err, cnt;
+	struct zb_slt_info slt_info;
+	u8_t buf[ZB_CRC32_BUF_SIZE];
+	u32_t crc_ref = 0U, crc = 0U, start, cyc_ref, cyc, off, len;
+
+	/* check value of the IEEE crc32 */
+	crc = zb_crc32_update(0U, (const u8_t *)"123456789", 9);
+	zassert_true(crc == 0xcbf43926, "Wrong crc32 [%x]", crc);
+
+	cnt = zb_slt_area_cnt();
+	zassert_false(cnt == 0,  "Unable to get slotarea count: [cnt %d]", cnt);
+
+	err = zb_slt_open(&slt_info, cnt - 1, RUN);
+	zassert_true(err == 0,  "Unable to get info: [err %d]", err);
+
+	len = MIN(slt_info.size, BENCH_CRC32_SIZE);
+	err = zb_erase(&slt_info, 0, slt_info.size);
+	zassert_true(err == 0,  "Unable to erase RUN area: [err %d]", err);
+
+	for (off = 0; off < len; off += sizeof(buf)) {
+		for (cnt = 0; cnt < sizeof(buf); cnt++) {
+			buf[cnt] = (u8_t)(off / 3 + cnt);
+		}
+		err = zb_write(&slt_info, off, buf, sizeof(buf));
+		zassert_true(err == 0,  "Unable to write data: [err %d]", err);
+	}
+
+	/* read errors are collected and checked after the timing */
+	err = 0;
+	start = k_cycle_get_32();
+	for (off = 0; off < len; off += 32) {
+		err |= zb_read(&slt_info, off, buf, 32);
+		crc_ref = crc32_ieee_update(crc_ref, buf, 32);
+	}
+	cyc_ref = k_cycle_get_32() - start;
+	zassert_true(err == 0,  "Unable to read data: [err %d]", err);
+
+	/* first call includes the table calculation */
+	crc = 0U;
+	start = k_cycle_get_32();
+	for (off = 0; off < len; off += sizeof(buf)) {
+		err |= zb_read(&slt_info, off, buf, sizeof(buf));
+		crc = zb_crc32_update(crc, buf, sizeof(buf));
+	}
+	cyc = k_cycle_get_32() - start;
+	zassert_true(err == 0,  "Unable to read data: [err %d]", err);
+
+	zassert_true(crc == crc_ref, "crc32 differs [%x] [%x]", crc, crc_ref);
+
+	TC_PRINT("crc32 %u bytes: bitwise %u us, %d slices %u us\n", len,
+		 bench_us(cyc_ref), CONFIG_ZB_EIGHT_CRC32_SLICES,
+		 bench_us(cyc));
+}
+
 void test_zb_flash(void)
 {
 	ztest_test_suite(test_zb_flash,
 			 ztest_unit_test(test_zb_slt_open),
 			 ztest_unit_test(test_zb_sectorsize_get),
 			 ztest_unit_test(test_zb_ewr),
-			 ztest_unit_test(test_zb_cmd)
+			 ztest_unit_test(test_zb_cmd),
+			 ztest_unit_test(test_zb_crc32)
 			);
 
 	ztest_run_test_suite(test_zb_flash);
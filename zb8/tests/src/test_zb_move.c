@@ -11,6 +11,8 @@
 #include <zb8/zb8_move.h>
 #include <zb8/zb8_flash.h>
 #include <zb8/zb8_image.h>
+#include <zb8/zb8_confirm.h>
+#include <zb8/zb8_fsl.h>
 
 #include <logging/log.h>
 LOG_MODULE_REGISTER(test_zb_move);
@@ -271,12 +273,279 @@ void test_zb_image_pattern_0(void)
 
 }
 
+/**
+ * @brief Test a upgrade with a bad image hash, the run image is kept
+ */
+void test_zb_image_bad_hash(void)
+{
+	int cnt, err;
+	struct zb_slt_info slt_info;
+	u8_t image[HDR_SIZE + IMG_SIZE];
+	u8_t run_image[HDR_SIZE + IMG_SIZE];
+
+	cnt = 0;
+	err = zb_slt_open(&slt_info, cnt, RUN);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_read(&slt_info, 0, run_image, sizeof(run_image));
+	zassert_true(err == 0, "Unable to read run image");
+
+	memcpy(image, test_image2_enc, sizeof(image));
+	image[HDR_SIZE + 100] ^= 0x01;
+
+	LOG_INF("Upgrade to test_image2_enc with a bad hash");
+	err = zb_slt_open(&slt_info, cnt, UPGRADE);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_erase(&slt_info, 0U, slt_info.size);
+	zassert_true(err == 0,  "Failed to erase UPGRADE area");
+	err = zb_write(&slt_info, 0, image, sizeof(image));
+	zassert_true(err == 0,  "Unable to write image: [err %d]", err);
+	err = zb_slt_open(&slt_info, cnt, SWPSTAT);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_erase(&slt_info, 0, slt_info.size);
+	zassert_true(err == 0,  "Unable to erase SWPSTAT area: [err %d]", err);
+
+	/* rejected before the swap or restored after the copy */
+	(void)zb_img_swap(cnt);
+
+	err = zb_slt_open(&slt_info, cnt, RUN);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_read(&slt_info, 0, image, sizeof(image));
+	zassert_true(err == 0, "Unable to read run image");
+	err = memcmp(&image[HDR_SKIP], &run_image[HDR_SKIP],
+		     HDR_SIZE-HDR_SKIP);
+	zassert_true(err == 0, "Difference detected in run header");
+	err = memcmp(&image[HDR_SIZE], &run_image[HDR_SIZE], IMG_SIZE);
+	zassert_true(err == 0, "Difference detected in run image");
+}
+
+#define RESUME_LEN (HDR_SIZE + IMG_SIZE)
+#define RESUME_TOP 0xfe /* the top sector of the run image */
+#define RESUME_NONE 0xff
+
+/* State of the slots when the power failed during a swap with the image hash
+ * check, the swap resumes from the cmd in the swap status.
+ */
+struct resume_state {
+	u8_t cmd2;
+	u8_t cmd3;
+	u8_t move_from; /* first sector of the run image in the move slot */
+	bool run0_upg;  /* run sector 0 holds the upgrade sector 0 */
+	bool upg0_move; /* upgrade sector 0 holds the move sector 0 */
+	bool upgraded;  /* the swap ends with the upgrade image */
+};
+
+static const struct resume_state resume_states[] = {
+	{CMD_EMPTY, CMD_EMPTY, RESUME_NONE, false, false, true},
+	{CMD2_RUN2MOV, RESUME_TOP, RESUME_NONE, false, false, true},
+	{CMD2_RUN2MOV, 0, 1, false, false, true},
+	{CMD2_UPG2RUN, 0, 0, false, false, false},
+	{CMD2_MOV2UPG, 0, 0, true, false, false},
+	{CMD2_UPG2RUN, 1, 0, true, true, false},
+};
+
+static void resume_write(u8_t sm_idx, enum slot slt, u32_t off, u32_t ss,
+			 const u8_t *data)
+{
+	int err;
+	struct zb_slt_info slt_info;
+
+	err = zb_slt_open(&slt_info, sm_idx, slt);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_erase(&slt_info, off, ss);
+	zassert_true(err == 0,  "Unable to erase sector: [err %d]", err);
+	err = zb_write(&slt_info, off, data + off, MIN(ss, RESUME_LEN - off));
+	zassert_true(err == 0,  "Unable to write sector: [err %d]", err);
+}
+
+static void resume_upgrade(u8_t sm_idx, const unsigned char *image,
+			   bool swap)
+{
+	int err;
+	struct zb_slt_info slt_info;
+
+	err = zb_slt_open(&slt_info, sm_idx, UPGRADE);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_erase(&slt_info, 0U, slt_info.size);
+	zassert_true(err == 0,  "Failed to erase UPGRADE area");
+	err = zb_write(&slt_info, 0, image, RESUME_LEN);
+	zassert_true(err == 0,  "Unable to write image: [err %d]", err);
+	err = zb_slt_open(&slt_info, sm_idx, SWPSTAT);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_erase(&slt_info, 0, slt_info.size);
+	zassert_true(err == 0,  "Unable to erase SWPSTAT area: [err %d]", err);
+	/* a upgrade request erases the verify area */
+	err = zb_slt_open(&slt_info, sm_idx, VERIFY);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_erase(&slt_info, 0, slt_info.size);
+	zassert_true(err == 0,  "Unable to erase VERIFY area: [err %d]", err);
+
+	if (swap) {
+		err = zb_img_swap(sm_idx);
+		zassert_true(err == 0,  "SWAP returned error: [err %d]", err);
+	}
+}
+
+/**
+ * @brief Test a swap with the image hash check resumed at each cmd state,
+ * the run slot ends with the upgrade image or with the old run image.
+ */
+void test_zb_image_resume_hash(void)
+{
+	int cnt, err;
+	struct zb_slt_info slt_info;
+	struct zb_cmd cmd;
+	const struct resume_state *st;
+	u8_t image[RESUME_LEN];
+	u8_t run_image[RESUME_LEN];
+	u32_t ss, top, off;
+
+	cnt = 0;
+	ss = zb_sectorsize_get(cnt);
+	zassert_false(ss == 0,  "Unable to get sectorsize");
+	top = (RESUME_LEN - 1) / ss;
+
+	for (st = resume_states; st < resume_states +
+	     ARRAY_SIZE(resume_states); st++) {
+		if ((st->cmd3 != CMD_EMPTY) && (st->cmd3 != RESUME_TOP) &&
+		    (st->cmd3 > top)) {
+			continue;
+		}
+
+		LOG_INF("Resume at cmd2 %x cmd3 %x", st->cmd2, st->cmd3);
+		err = zb_slt_open(&slt_info, cnt, RUN);
+		zassert_true(err == 0,  "Unable to get slotarea info: [err %d]",
+			     err);
+		err = zb_erase(&slt_info, 0U, slt_info.size);
+		zassert_true(err == 0,  "Failed to erase RUN area");
+		resume_upgrade(cnt, test_image1_enc, true);
+		err = zb_read(&slt_info, 0, run_image, RESUME_LEN);
+		zassert_true(err == 0, "Unable to read run image");
+
+		resume_upgrade(cnt, test_image2_enc, false);
+
+		/* the move slot holds a stale image or part of the run image */
+		err = zb_slt_open(&slt_info, cnt, MOVE);
+		zassert_true(err == 0,  "Unable to get slotarea info: [err %d]",
+			     err);
+		err = zb_erase(&slt_info, 0U, slt_info.size);
+		zassert_true(err == 0,  "Failed to erase MOVE area");
+		err = zb_write(&slt_info, 0, test_image_pln, RESUME_LEN);
+		zassert_true(err == 0,  "Unable to write image: [err %d]", err);
+		for (off = 0; off <= top * ss; off += ss) {
+			if (off / ss >= st->move_from) {
+				resume_write(cnt, MOVE, off, ss, run_image);
+			}
+		}
+
+		if (st->run0_upg) {
+			resume_write(cnt, RUN, 0, ss, test_image2_enc);
+		}
+
+		if (st->upg0_move) {
+			resume_write(cnt, UPGRADE, 0, ss, run_image);
+		}
+
+		cmd.cmd1 = CMD1_SWAP_HASH;
+		cmd.cmd2 = st->cmd2;
+		cmd.cmd3 = (st->cmd3 == RESUME_TOP) ? top : st->cmd3;
+		err = zb_slt_open(&slt_info, cnt, SWPSTAT);
+		zassert_true(err == 0,  "Unable to get slotarea info: [err %d]",
+			     err);
+		err = zb_cmd_write(&slt_info, &cmd);
+		zassert_true(err == 0,  "Unable to write cmd: [err %d]", err);
+
+		err = zb_img_swap(cnt);
+		zassert_true(err == 0,  "SWAP returned error: [err %d]", err);
+
+		err = zb_slt_open(&slt_info, cnt, RUN);
+		zassert_true(err == 0,  "Unable to get slotarea info: [err %d]",
+			     err);
+		err = zb_read(&slt_info, 0, image, RESUME_LEN);
+		zassert_true(err == 0, "Unable to read run image");
+		if (st->upgraded) {
+			err = memcmp(&image[HDR_SKIP],
+				     &test_image2_enc[HDR_SKIP],
+				     HDR_SIZE - HDR_SKIP);
+			zassert_true(err == 0, "Upgrade not in run slot");
+		} else {
+			err = memcmp(&image[HDR_SKIP], &run_image[HDR_SKIP],
+				     RESUME_LEN - HDR_SKIP);
+			zassert_true(err == 0, "Run image not restored");
+		}
+	}
+}
+
+/**
+ * @brief Test the confirmation and validation of the run image
+ */
+void test_zb_slt_confirm(void)
+{
+	int cnt, err;
+	struct zb_slt_info slt_info;
+	struct zb_fsl_hdr hdr;
+	u8_t image[HDR_SIZE + IMG_SIZE];
+	u32_t ss, end, off;
+
+	cnt = 0;
+	err = zb_slt_confirm(cnt);
+	zassert_true(err == 0,  "Unable to confirm image: [err %d]", err);
+	err = zb_slt_validate(cnt);
+	zassert_true(err == 0,  "Confirmed image is invalid: [err %d]", err);
+
+	/* a upgrade request erases the verify area */
+	err = zb_slt_open(&slt_info, cnt, VERIFY);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_erase(&slt_info, 0, slt_info.size);
+	zassert_true(err == 0,  "Unable to erase VERIFY area: [err %d]", err);
+	err = zb_slt_validate(cnt);
+	zassert_false(err == 0,  "Unconfirmed image is valid");
+
+	err = zb_slt_confirm(cnt);
+	zassert_true(err == 0,  "Unable to confirm image: [err %d]", err);
+	err = zb_slt_validate(cnt);
+	zassert_true(err == 0,  "Confirmed image is invalid: [err %d]", err);
+
+	/* a change of the last image byte is found, also with the verify
+	 * record (it is in the body fingerprint)
+	 */
+	err = zb_slt_open(&slt_info, cnt, RUN);
+	zassert_true(err == 0,  "Unable to get slotarea info: [err %d]", err);
+	err = zb_read(&slt_info, 0, &hdr, sizeof(struct zb_fsl_hdr));
+	zassert_true(err == 0, "Unable to read run header");
+	ss = zb_sectorsize_get(cnt);
+	zassert_false(ss == 0,  "Unable to get sectorsize");
+	end = hdr.hdr_info.size + hdr.size;
+	off = ((end - 1) / ss) * ss;
+	zassert_true(end - off <= sizeof(image), "Image tail too large");
+	err = zb_read(&slt_info, off, image, end - off);
+	zassert_true(err == 0, "Unable to read image tail");
+
+	image[end - off - 1] ^= 0x01;
+	err = zb_erase(&slt_info, off, ss);
+	zassert_true(err == 0,  "Unable to erase sector: [err %d]", err);
+	err = zb_write(&slt_info, off, image, end - off);
+	zassert_true(err == 0,  "Unable to write image tail: [err %d]", err);
+	err = zb_slt_validate(cnt);
+	zassert_false(err == 0,  "Changed image is valid");
+
+	image[end - off - 1] ^= 0x01;
+	err = zb_erase(&slt_info, off, ss);
+	zassert_true(err == 0,  "Unable to erase sector: [err %d]", err);
+	err = zb_write(&slt_info, off, image, end - off);
+	zassert_true(err == 0,  "Unable to write image tail: [err %d]", err);
+	err = zb_slt_validate(cnt);
+	zassert_true(err == 0,  "Confirmed image is invalid: [err %d]", err);
+}
+
 void test_zb_move(void)
 {
 	ztest_test_suite(test_zb_move,
 			 ztest_unit_test(test_zb_image_move_pln),
 			 ztest_unit_test(test_zb_image_move_enc),
-			 ztest_unit_test(test_zb_image_pattern_0)
+			 ztest_unit_test(test_zb_image_pattern_0),
+			 ztest_unit_test(test_zb_image_bad_hash),
+			 ztest_unit_test(test_zb_image_resume_hash),
+			 ztest_unit_test(test_zb_slt_confirm)
 			);
 
 	ztest_run_test_suite(test_zb_move);
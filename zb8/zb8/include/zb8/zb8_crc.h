@@ -0,0 +1,46 @@
+/*
+ * Copyright (c) 2019 Laczen
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef H_ZB_EIGHT_CRC_
+#define H_ZB_EIGHT_CRC_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <zephyr.h>
+
+/* Read size used when the crc32 of a image is calculated */
+#define ZB_CRC32_BUF_SIZE 256
+
+/**
+ * @brief crc API
+ * @{
+ */
+
+/**
+ * @brief zb_crc32_update
+ *
+ * Update a crc32 (IEEE) with data, equal to crc32_ieee_update(). Depending
+ * on CONFIG_ZB_EIGHT_CRC32_SLICES the crc32 is calculated bitwise, with a
+ * table or with slice-by-4/8 tables.
+ *
+ * @param crc crc32 of the preceding data (0 for the first call)
+ * @param data pointer to data
+ * @param len data length
+ * @retval updated crc32
+ *
+ */
+u32_t zb_crc32_update(u32_t crc, const u8_t *data, size_t len);
+
+/**
+ * @}
+ */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
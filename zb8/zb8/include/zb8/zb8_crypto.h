@@ -24,6 +24,28 @@
 extern "C" {
 #endif
 
+/* Buffer to hash, decrypt and move images, the routines that use it are not
+ * reentrant.
+ */
+extern u8_t zb_work_buf[CONFIG_ZB_EIGHT_WORK_BUF_SIZE];
+
+/**
+ * @brief zb_aes_ctr: aes ctr keystream state
+ * @{
+ */
+
+struct zb_aes_ctr {
+	struct tc_aes_key_sched_struct sched;
+	u8_t key[AES_KEY_SIZE];		/**< key of sched */
+	u8_t nonce[AES_BLOCK_SIZE];	/**< counter of block 0 */
+	u8_t ctr[AES_BLOCK_SIZE];	/**< counter of the next block */
+	bool sched_ok;			/**< sched is expanded for key */
+};
+
+/**
+ * @}
+ */
+
 /** @brief crypto API
  * @{
  */
@@ -42,6 +64,47 @@ extern "C" {
  */
 int zb_aes_ctr_mode(u8_t *buf, size_t len, u8_t *ctr, const u8_t *key);
 
+/**
+ * @brief zb_aes_ctr_init
+ *
+ * Prepare ctx for a aes ctr calculation with key and nonce, the counter is
+ * set to block 0. The key schedule is only expanded when the key differs
+ * from the previous key of ctx, a zeroed ctx has no key.
+ *
+ * @param ctx aes ctr state
+ * @param key encryption key
+ * @param nonce counter of block 0 (as byte array)
+ * @retval 0 Success
+ * @retval -ERRNO errno code if error
+ */
+int zb_aes_ctr_init(struct zb_aes_ctr *ctx, const u8_t *key,
+		    const u8_t *nonce);
+
+/**
+ * @brief zb_aes_ctr_seek
+ *
+ * Set the counter of ctx to block blk (the counter is nonce + blk).
+ *
+ * @param ctx aes ctr state
+ * @param blk block index (block 0 uses nonce)
+ */
+void zb_aes_ctr_seek(struct zb_aes_ctr *ctx, u32_t blk);
+
+/**
+ * @brief zb_aes_ctr_crypt
+ *
+ * Encrypt / decrypt buf starting at the block of the counter of ctx, the
+ * counter is advanced by the number of blocks used. A partial last block
+ * uses a whole block of keystream.
+ *
+ * @param ctx aes ctr state
+ * @param buf pointer to buffer to encrypt / encrypted buffer
+ * @param len bytes to encrypt
+ * @retval 0 Success
+ * @retval -ERRNO errno code if error
+ */
+int zb_aes_ctr_crypt(struct zb_aes_ctr *ctx, u8_t *buf, size_t len);
+
 /**
  * @brief zb_get_encr_key_nonce
  *
@@ -75,7 +138,8 @@ int zb_sign_verify(const u8_t *hash, const u8_t *signature);
 /**
  * @brief zb_hash
  *
- * Calculates the hash (SHA256) over a region.
+ * Calculates the hash (SHA256) over a region. The region is read in blocks
+ * of CONFIG_ZB_EIGHT_WORK_BUF_SIZE using zb_work_buf.
  *
  * @param hash: calculated message hash
  * @param info: region info in zb_slot_info format
@@ -40,11 +40,20 @@ struct zb_fsl_hdr {
 	u32_t pad0;
 };
 
+/* With CONFIG_ZB_EIGHT_VERIFY_RECORD the crc32 of the image header and a
+ * fingerprint of the image body are stored with magic FSL_VER_MAGIC, a image
+ * with the same header and fingerprint is then accepted without the crc32 of
+ * the complete image. The fingerprint is the crc32 of FSL_VER_SAMPLES words
+ * spread over the body followed by the last block (ZB_CRC32_BUF_SIZE) of the
+ * body.
+ */
+#define FSL_VER_SAMPLES 16
+
 struct zb_fsl_verify_hdr {
-	u32_t crc32;
-	u32_t pad0;
-	u32_t pad1;
-	u32_t pad2;
+	u32_t crc32;		/* crc32 of image header and image */
+	u32_t magic;		/* FSL_VER_MAGIC if hdr_crc32 is valid */
+	u32_t hdr_crc32;	/* crc32 of the image header */
+	u32_t body_crc32;	/* fingerprint of the image body */
 	u32_t pad3;
 	u32_t pad4;
 	u32_t pad5;
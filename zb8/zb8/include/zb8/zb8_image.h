@@ -40,6 +40,7 @@ struct zb_img_info {
     	u32_t build;
     	u8_t enc_key[AES_KEY_SIZE];
     	u8_t enc_nonce[AES_KEY_SIZE];
+	u8_t img_hash[HASH_BYTES];
     	bool hdr_ok;
     	bool img_ok;
     	bool dep_ok;
@@ -14,8 +14,6 @@
 extern "C" {
 #endif
 
-#define MOVE_BLOCK_SIZE 512
-
 /*
  * Commands are written to flash as a set of 3 bytes (cmd1, cmd2, cmd3)
  * followed by a crc8. cmd1 is used to track general properties: type of swap,
@@ -27,6 +25,12 @@ extern "C" {
 
 /* cmd1 definitions */
 #define CMD1_SWAP		0b01111111
+#define CMD1_SWAP_HASH		0b00111111 /* Swap, the upgrade image hash is
+					    * verified at the end of UPG2RUN
+					    */
+#define CMD1_SWAP_RESTORE	0b00011111 /* Restore the image in the move
+					    * slot to the run slot
+					    */
 #define CMD1_ERROR		0b00000000
 
 
@@ -56,6 +60,8 @@ typedef struct {
 	struct zb_slt_info *from; /* from slot */
 	struct zb_slt_info *to;   /* to slot */
 	u32_t offset; /* offset of sector that is moved */
+	struct tc_sha256_state_struct *sha; /* hash of moved image or NULL */
+	struct zb_aes_ctr *ctr; /* key schedule kept for the moved image */
 } zb_move_cmd;
 
 /**
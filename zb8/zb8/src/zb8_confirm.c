@@ -8,19 +8,21 @@
 #include <zb8/zb8_flash.h>
 #include <zb8/zb8_slot.h>
 #include <zb8/zb8_fsl.h>
+#include <zb8/zb8_crc.h>
 
 #include <errno.h>
-#include <sys/crc.h>
 
 #include <logging/log.h>
 LOG_MODULE_DECLARE(zb8, CONFIG_ZB_EIGHT_LOG_LEVEL);
 
-static int zb_slt_crc32(u32_t *crc32, struct zb_slt_info *slt_info)
+/* crc32 of the image in slt_info, only of the header when hdr_only is set */
+static int zb_slt_crc32(u32_t *crc32, struct zb_slt_info *slt_info,
+			bool hdr_only)
 {
 	int rc;
 	struct zb_fsl_hdr hdr;
 	u32_t size, off = 0;
-	u8_t buf[32];
+	u8_t buf[ZB_CRC32_BUF_SIZE] __aligned(4);
 
 	rc = zb_read(slt_info, 0U, &hdr, sizeof(struct zb_fsl_hdr));
 	if (rc) {
@@ -31,14 +33,18 @@ static int zb_slt_crc32(u32_t *crc32, struct zb_slt_info *slt_info)
 		return -EFAULT;
 	}
 
-	size = hdr.hdr_info.size + hdr.size;
+	size = hdr.hdr_info.size;
+	if (!hdr_only) {
+		size += hdr.size;
+	}
+
 	while (size) {
 		size_t rdlen = MIN(size, sizeof(buf));
 		rc = zb_read(slt_info, off, &buf, rdlen);
 		if (rc) {
 			return rc;
 		}
-		*crc32 = crc32_ieee_update(*crc32, buf, rdlen);
+		*crc32 = zb_crc32_update(*crc32, buf, rdlen);
 		size -= rdlen;
 		off += rdlen;
 	}
@@ -46,6 +52,72 @@ static int zb_slt_crc32(u32_t *crc32, struct zb_slt_info *slt_info)
 	return 0;
 }
 
+/* Fingerprint of the body of the image in slt_info: crc32 of FSL_VER_SAMPLES
+ * words spread over the body followed by the last block of the body
+ */
+static int zb_slt_body_crc32(u32_t *crc32, struct zb_slt_info *slt_info)
+{
+	int rc;
+	struct zb_fsl_hdr hdr;
+	u32_t i, off, end;
+	size_t rdlen;
+	u8_t buf[ZB_CRC32_BUF_SIZE] __aligned(4);
+
+	rc = zb_read(slt_info, 0U, &hdr, sizeof(struct zb_fsl_hdr));
+	if (rc) {
+		return rc;
+	}
+
+	if (hdr.magic != FSL_MAGIC) {
+		return -EFAULT;
+	}
+
+	end = hdr.hdr_info.size + hdr.size;
+	for (i = 0U; i < FSL_VER_SAMPLES; i++) {
+		off = hdr.hdr_info.size +
+		      (((hdr.size / FSL_VER_SAMPLES) * i) & ~3U);
+		rdlen = MIN(end - off, sizeof(u32_t));
+		rc = zb_read(slt_info, off, &buf, rdlen);
+		if (rc) {
+			return rc;
+		}
+		*crc32 = zb_crc32_update(*crc32, buf, rdlen);
+	}
+
+	rdlen = MIN(hdr.size, sizeof(buf));
+	rc = zb_read(slt_info, end - rdlen, &buf, rdlen);
+	if (rc) {
+		return rc;
+	}
+	*crc32 = zb_crc32_update(*crc32, buf, rdlen);
+
+	return 0;
+}
+
+/* Are the header and the body fingerprint of the run image equal to those of
+ * the confirmed image
+ */
+static bool zb_slt_rec_confirmed(struct zb_slt_info *run,
+				 struct zb_fsl_verify_hdr *hdr)
+{
+	u32_t crc32 = 0U;
+
+	if (hdr->magic != FSL_VER_MAGIC) {
+		return false;
+	}
+
+	if ((zb_slt_crc32(&crc32, run, true)) || (crc32 != hdr->hdr_crc32)) {
+		return false;
+	}
+
+	crc32 = 0U;
+	if (zb_slt_body_crc32(&crc32, run)) {
+		return false;
+	}
+
+	return (crc32 == hdr->body_crc32);
+}
+
 int zb_slt_validate(u8_t sm_idx)
 {
 	int rc;
@@ -59,12 +131,18 @@ int zb_slt_validate(u8_t sm_idx)
 		return rc;
 	}
 
-	rc = zb_slt_crc32(&crc32, &run);
+	rc = zb_read(&ver, 0U, &hdr, sizeof(struct zb_fsl_verify_hdr));
 	if (rc) {
 		return rc;
 	}
 
-	rc = zb_read(&ver, 0U, &hdr, sizeof(struct zb_fsl_verify_hdr));
+	if ((IS_ENABLED(CONFIG_ZB_EIGHT_VERIFY_RECORD)) &&
+	    (zb_slt_rec_confirmed(&run, &hdr))) {
+		LOG_INF("Image unchanged since confirmation");
+		return 0;
+	}
+
+	rc = zb_slt_crc32(&crc32, &run, false);
 	if (rc) {
 		return rc;
 	}
@@ -89,7 +167,7 @@ int zb_slt_confirm(u8_t sm_idx)
 		return rc;
 	}
 
-	rc = zb_slt_crc32(&crc32, &run);
+	rc = zb_slt_crc32(&crc32, &run, false);
 	if (rc) {
 		return rc;
 	}
@@ -99,11 +177,26 @@ int zb_slt_confirm(u8_t sm_idx)
 		return rc;
 	}
 
-	if (hdr.crc32 == crc32) {
+	if ((hdr.crc32 == crc32) &&
+	    ((!IS_ENABLED(CONFIG_ZB_EIGHT_VERIFY_RECORD)) ||
+	     (zb_slt_rec_confirmed(&run, &hdr)))) {
 		return 0;
 	}
 
 	hdr.crc32 = crc32;
+	if (IS_ENABLED(CONFIG_ZB_EIGHT_VERIFY_RECORD)) {
+		hdr.hdr_crc32 = 0U;
+		rc = zb_slt_crc32(&hdr.hdr_crc32, &run, true);
+		if (rc) {
+			return rc;
+		}
+		hdr.body_crc32 = 0U;
+		rc = zb_slt_body_crc32(&hdr.body_crc32, &run);
+		if (rc) {
+			return rc;
+		}
+		hdr.magic = FSL_VER_MAGIC;
+	}
 
 	rc = zb_erase(&ver, 0U, ver.size);
 	if (rc) {
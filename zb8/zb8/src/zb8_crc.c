@@ -0,0 +1,94 @@
+/*
+ * Copyright (c) 2019 Laczen
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <zb8/zb8_crc.h>
+
+#include <sys/crc.h>
+#include <sys/byteorder.h>
+
+#define ZB_CRC32_POLY 0xedb88320 /* reflected IEEE polynomial */
+#define ZB_CRC32_SLICES CONFIG_ZB_EIGHT_CRC32_SLICES
+
+BUILD_ASSERT_MSG((ZB_CRC32_SLICES == 0) || (ZB_CRC32_SLICES == 1) ||
+		 (ZB_CRC32_SLICES == 4) || (ZB_CRC32_SLICES == 8),
+		 "ZB_EIGHT_CRC32_SLICES should be 0, 1, 4 or 8");
+
+#if (ZB_CRC32_SLICES == 0)
+u32_t zb_crc32_update(u32_t crc, const u8_t *data, size_t len)
+{
+	return crc32_ieee_update(crc, data, len);
+}
+#else
+/* The tables are calculated at the first call, table 0 is the byte table,
+ * table k gives the crc of a byte followed by k zero bytes.
+ */
+static u32_t zb_crc32_tbl[ZB_CRC32_SLICES][256];
+static bool zb_crc32_tbl_ok;
+
+static void zb_crc32_tbl_init(void)
+{
+	u32_t crc;
+	int i, j;
+
+	for (i = 0; i < 256; i++) {
+		crc = (u32_t)i;
+		for (j = 0; j < 8; j++) {
+			crc = (crc >> 1) ^ (ZB_CRC32_POLY & -(crc & 1));
+		}
+		zb_crc32_tbl[0][i] = crc;
+	}
+
+	for (i = 0; i < 256; i++) {
+		for (j = 1; j < ZB_CRC32_SLICES; j++) {
+			crc = zb_crc32_tbl[j - 1][i];
+			zb_crc32_tbl[j][i] = (crc >> 8) ^
+					     zb_crc32_tbl[0][crc & 0xff];
+		}
+	}
+
+	zb_crc32_tbl_ok = true;
+}
+
+u32_t zb_crc32_update(u32_t crc, const u8_t *data, size_t len)
+{
+	u32_t (*tbl)[256] = zb_crc32_tbl;
+
+	if (!zb_crc32_tbl_ok) {
+		zb_crc32_tbl_init();
+	}
+
+	crc = ~crc;
+
+#if (ZB_CRC32_SLICES == 8)
+	while (len >= 8) {
+		u32_t w0 = sys_get_le32(data) ^ crc;
+		u32_t w1 = sys_get_le32(data + 4);
+
+		crc = tbl[7][w0 & 0xff] ^ tbl[6][(w0 >> 8) & 0xff] ^
+		      tbl[5][(w0 >> 16) & 0xff] ^ tbl[4][w0 >> 24] ^
+		      tbl[3][w1 & 0xff] ^ tbl[2][(w1 >> 8) & 0xff] ^
+		      tbl[1][(w1 >> 16) & 0xff] ^ tbl[0][w1 >> 24];
+		data += 8;
+		len -= 8;
+	}
+#elif (ZB_CRC32_SLICES == 4)
+	while (len >= 4) {
+		u32_t w0 = sys_get_le32(data) ^ crc;
+
+		crc = tbl[3][w0 & 0xff] ^ tbl[2][(w0 >> 8) & 0xff] ^
+		      tbl[1][(w0 >> 16) & 0xff] ^ tbl[0][w0 >> 24];
+		data += 4;
+		len -= 4;
+	}
+#endif
+
+	while (len--) {
+		crc = tbl[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+	}
+
+	return ~crc;
+}
+#endif /* ZB_CRC32_SLICES == 0 */
@@ -15,6 +15,11 @@
 #include <logging/log.h>
 LOG_MODULE_DECLARE(zb8, CONFIG_ZB_EIGHT_LOG_LEVEL);
 
+BUILD_ASSERT_MSG((CONFIG_ZB_EIGHT_WORK_BUF_SIZE % AES_BLOCK_SIZE) == 0,
+		 "ZB_EIGHT_WORK_BUF_SIZE is not a multiple of AES_BLOCK_SIZE");
+
+u8_t zb_work_buf[CONFIG_ZB_EIGHT_WORK_BUF_SIZE] __aligned(4);
+
 extern const u8_t ec256_boot_pri_key[];
 extern const u16_t ec256_boot_pri_key_len;
 extern const u8_t ec256_root_pub_key[];
@@ -89,24 +94,29 @@ int zb_hash(u8_t *hash, struct zb_slt_info *info, u32_t off, size_t len)
 {
 	int rc;
 	struct tc_sha256_state_struct s;
-	u8_t buf[HASH_BYTES];
+	size_t buf_len;
 
 	if (!tc_sha256_init(&s)) {
 		return -EFAULT;
 	}
 
+	/* The first read ends at a buffer size boundary, the next reads are
+	 * then aligned to the buffer size (e.g. whole flash pages).
+	 */
+	buf_len = sizeof(zb_work_buf) - (off % sizeof(zb_work_buf));
 	while (len) {
-		size_t buf_len = MIN(HASH_BYTES, len);
-		rc = zb_read(info, off, buf, buf_len);
+		buf_len = MIN(buf_len, len);
+		rc = zb_read(info, off, zb_work_buf, buf_len);
 		if (rc) {
 			return rc;
 		}
 
-		if (!tc_sha256_update(&s, buf, buf_len)) {
+		if (!tc_sha256_update(&s, zb_work_buf, buf_len)) {
 			return -EFAULT;
 		}
 		off += buf_len;
 		len -= buf_len;
+		buf_len = sizeof(zb_work_buf);
 	}
 
 	if (!tc_sha256_final(hash, &s)) {
@@ -116,35 +126,92 @@ int zb_hash(u8_t *hash, struct zb_slt_info *info, u32_t off, size_t len)
 	return 0;
 }
 
-int zb_aes_ctr_mode(u8_t *buf, size_t len, u8_t *ctr, const u8_t *key)
+/* Add n to the big endian counter ctr */
+static void zb_aes_ctr_add(u8_t *ctr, u32_t n)
+{
+	u32_t sum;
+	int j;
+
+	for (j = AES_BLOCK_SIZE; (j > 0) && (n); --j) {
+		sum = ctr[j - 1] + (n & 0xff);
+		ctr[j - 1] = (u8_t)sum;
+		n = (n >> 8) + (sum >> 8);
+	}
+}
+
+int zb_aes_ctr_init(struct zb_aes_ctr *ctx, const u8_t *key,
+		    const u8_t *nonce)
+{
+	if ((!ctx->sched_ok) || (memcmp(ctx->key, key, AES_KEY_SIZE))) {
+		ctx->sched_ok = false;
+		if (!tc_aes128_set_encrypt_key(&ctx->sched, key)) {
+			return -EFAULT;
+		}
+		memcpy(ctx->key, key, AES_KEY_SIZE);
+		ctx->sched_ok = true;
+	}
+
+	memcpy(ctx->nonce, nonce, AES_BLOCK_SIZE);
+	memcpy(ctx->ctr, nonce, AES_BLOCK_SIZE);
+	return 0;
+}
+
+void zb_aes_ctr_seek(struct zb_aes_ctr *ctx, u32_t blk)
+{
+	memcpy(ctx->ctr, ctx->nonce, AES_BLOCK_SIZE);
+	zb_aes_ctr_add(ctx->ctr, blk);
+}
+
+int zb_aes_ctr_crypt(struct zb_aes_ctr *ctx, u8_t *buf, size_t len)
 {
-	struct tc_aes_key_sched_struct sched;
-	u8_t buffer[AES_BLOCK_SIZE];
-	u8_t nonce[AES_BLOCK_SIZE];
-	u32_t i;
-	u8_t blk_off, j, u8;
-
-
-	(void)memcpy(nonce, ctr, sizeof(nonce));
-	(void)tc_aes128_set_encrypt_key(&sched, key);
-	for (i = 0; i < len; i++) {
-		blk_off = i & (AES_BLOCK_SIZE - 1);
-		if (blk_off == 0) {
-			if (tc_aes_encrypt(buffer, nonce, &sched)) {
-				for (j = AES_BLOCK_SIZE; j > 0; --j) {
-                			if (++nonce[j - 1] != 0) {
-                    				break;
-                			}
-            			}
-			} else {
-				return -EFAULT;
+	u32_t ks[AES_BLOCK_SIZE / sizeof(u32_t)];
+	u8_t *ks8 = (u8_t *)ks;
+	size_t blen, i;
+
+	if (!ctx->sched_ok) {
+		return -EINVAL;
+	}
+
+	while (len) {
+		if (!tc_aes_encrypt(ks8, ctx->ctr, &ctx->sched)) {
+			return -EFAULT;
+		}
+		zb_aes_ctr_add(ctx->ctr, 1U);
+
+		blen = MIN(len, AES_BLOCK_SIZE);
+		if ((blen == AES_BLOCK_SIZE) &&
+		    (((uintptr_t)buf & (sizeof(u32_t) - 1)) == 0U)) {
+			/* word wide xor on a aligned block */
+			u32_t *buf32 = (u32_t *)buf;
+
+			for (i = 0; i < ARRAY_SIZE(ks); i++) {
+				buf32[i] ^= ks[i];
+			}
+		} else {
+			for (i = 0; i < blen; i++) {
+				buf[i] ^= ks8[i];
 			}
 		}
-		/* update output */
-		u8 = *buf;
-		*buf++ = u8 ^ buffer[blk_off];
+		buf += blen;
+		len -= blen;
 	}
-	(void)memcpy(ctr, nonce, sizeof(nonce));
 
+	memset(ks, 0, sizeof(ks));
 	return 0;
-}
\ No newline at end of file
+}
+
+int zb_aes_ctr_mode(u8_t *buf, size_t len, u8_t *ctr, const u8_t *key)
+{
+	struct zb_aes_ctr ctx;
+	int rc;
+
+	ctx.sched_ok = false;
+	rc = zb_aes_ctr_init(&ctx, key, ctr);
+	if (!rc) {
+		rc = zb_aes_ctr_crypt(&ctx, buf, len);
+		(void)memcpy(ctr, ctx.ctr, AES_BLOCK_SIZE);
+	}
+
+	memset(&ctx, 0, sizeof(ctx));
+	return rc;
+}
@@ -5,9 +5,9 @@
  */
 
 #include <zb8/zb8_fsl.h>
+#include <zb8/zb8_crc.h>
 #include <drivers/flash.h>
 #include <soc.h>
-#include <sys/crc.h>
 #include <irq.h>
 
 #include <logging/log.h>
@@ -154,13 +154,52 @@ void zb_fsl_jump_run(void)
 	}
 }
 
+static u32_t zb_fsl_crc32(struct device *fl_dev, u32_t off, u32_t size)
+{
+	u32_t crc32 = 0U;
+	u8_t buf[ZB_CRC32_BUF_SIZE] __aligned(4);
+
+	while (size) {
+		size_t rdlen = MIN(size, sizeof(buf));
+		(void)flash_read(fl_dev, off, &buf, rdlen);
+		crc32 = zb_crc32_update(crc32, buf, rdlen);
+		size -= rdlen;
+		off += rdlen;
+	}
+	return crc32;
+}
+
+/* Fingerprint of the body of the image at off with header hdr, see
+ * struct zb_fsl_verify_hdr
+ */
+static u32_t zb_fsl_body_crc32(struct device *fl_dev, u32_t off,
+			       struct zb_fsl_hdr *hdr)
+{
+	u32_t crc32 = 0U;
+	u32_t i, sample, end;
+	size_t rdlen;
+	u8_t buf[ZB_CRC32_BUF_SIZE] __aligned(4);
+
+	end = hdr->hdr_info.size + hdr->size;
+	for (i = 0U; i < FSL_VER_SAMPLES; i++) {
+		sample = hdr->hdr_info.size +
+			 (((hdr->size / FSL_VER_SAMPLES) * i) & ~3U);
+		rdlen = MIN(end - sample, sizeof(u32_t));
+		(void)flash_read(fl_dev, off + sample, &buf, rdlen);
+		crc32 = zb_crc32_update(crc32, buf, rdlen);
+	}
+
+	rdlen = MIN(hdr->size, sizeof(buf));
+	(void)flash_read(fl_dev, off + end - rdlen, &buf, rdlen);
+	return zb_crc32_update(crc32, buf, rdlen);
+}
+
 void zb_fsl_boot(void)
 {
 	struct zb_fsl_hdr hdr;
 	struct zb_fsl_verify_hdr ver;
 	struct device *fl_dev;
-	u32_t crc32 = 0U, off, size;
-	u8_t buf[32];
+	u32_t crc32, off;
 
 	fl_dev = device_get_binding(FSL_DEV);
 	off = FSL_VERIFY_OFFSET;
@@ -170,13 +209,16 @@ void zb_fsl_boot(void)
 	(void)flash_read(fl_dev, off, &hdr, sizeof(struct zb_fsl_hdr));
 
 	if (hdr.magic == FSL_MAGIC) {
-		size = hdr.hdr_info.size + hdr.size;
-		while (size) {
-			size_t rdlen = MIN(size, sizeof(buf));
-			(void)flash_read(fl_dev, off, &buf, rdlen);
-			crc32 = crc32_ieee_update(crc32, buf, rdlen);
-			size -= rdlen;
-			off += rdlen;
+		if ((IS_ENABLED(CONFIG_ZB_EIGHT_VERIFY_RECORD)) &&
+		    (ver.magic == FSL_VER_MAGIC) &&
+		    (zb_fsl_crc32(fl_dev, off, hdr.hdr_info.size) ==
+		     ver.hdr_crc32) &&
+		    (zb_fsl_body_crc32(fl_dev, off, &hdr) == ver.body_crc32)) {
+			/* image unchanged since it was confirmed */
+			crc32 = ver.crc32;
+		} else {
+			crc32 = zb_fsl_crc32(fl_dev, off,
+					     hdr.hdr_info.size + hdr.size);
 		}
 
 		if (crc32 == ver.crc32) {
@@ -167,6 +167,7 @@ static int img_get_info(struct zb_img_info *info, struct zb_slt_info *slt_info,
 	if (entry.type != TLVE_IMAGE_HASH) {
 		return -EFAULT;
 	}
+	memcpy(info->img_hash, entry.value, HASH_BYTES);
 
 	if (!info->img_ok) {
 		rc = zb_hash(imghash, slt_info, info->start, hdr.size);
@@ -11,12 +11,33 @@
 #include <zb8/zb8_confirm.h>
 
 #include <errno.h>
+#include <tinycrypt/sha256.h>
 
 #include <logging/log.h>
 LOG_MODULE_DECLARE(zb8, CONFIG_ZB_EIGHT_LOG_LEVEL);
 
 int zb_img_move(zb_move_cmd *mcmd, size_t len);
 
+/* The key schedules are kept over the moves of the sectors of the upgrade
+ * image (UPG2RUN) and of the move image (MOV2UPG)
+ */
+static struct zb_aes_ctr zb_upgr_ctr;
+static struct zb_aes_ctr zb_move_ctr;
+
+/* Start to restore the image in the move slot to the run slot (in place and
+ * without decryption), the swap continues with UPG2RUN from sector 0.
+ */
+static void zb_img_restore(struct zb_cmd *cmd, struct zb_img_info *info)
+{
+	LOG_INF("Restoring the image in the move slot");
+	cmd->cmd1 = CMD1_SWAP_RESTORE;
+	cmd->cmd2 = CMD2_UPG2RUN;
+	cmd->cmd3 = 0;
+	zb_res_img_info(info);
+	info->img_ok = true;
+	info->dep_ok = true;
+}
+
 int zb_img_swap(uint8_t sm_idx) {
 
 	int rc, dp_err = 0;
@@ -24,6 +45,8 @@ int zb_img_swap(uint8_t sm_idx) {
 	zb_move_cmd mcmd;
 	struct zb_slt_info run_slt, move_slt, upgr_slt, swpstat_slt;
 	struct zb_img_info run_info, move_info, upgr_info;
+	struct tc_sha256_state_struct sha;
+	u8_t hash[HASH_BYTES];
 	bool in_place, save_stat, upg2run_done, mov2upg_done, continue_swap;
 	u32_t cmd_off, sectorsize;
 	u32_t len;
@@ -72,13 +95,42 @@ int zb_img_swap(uint8_t sm_idx) {
 	move_info.img_ok = true;
 	move_info.dep_ok = true;
 
+	if ((continue_swap) && (cmd.cmd1 == CMD1_SWAP_HASH)) {
+		if ((cmd.cmd2 == CMD_EMPTY) || (cmd.cmd2 == CMD2_RUN2MOV)) {
+			/* the run and upgrade slot are unchanged but the move
+			 * slot is incomplete, start the swap again
+			 */
+			continue_swap = false;
+		} else {
+			/* the hash state is lost, the upgrade image can't be
+			 * verified, restore the image in the move slot
+			 */
+			zb_img_restore(&cmd, &upgr_info);
+		}
+	}
+
+	if ((continue_swap) && (cmd.cmd1 == CMD1_SWAP_RESTORE)) {
+		(void)zb_slt_open(&upgr_slt, sm_idx, MOVE);
+		in_place = true;
+		upgr_info.img_ok = true;
+		upgr_info.dep_ok = true;
+	}
+
 	if (!continue_swap) {
+		cmd.cmd1 = CMD1_SWAP;
+		if ((IS_ENABLED(CONFIG_ZB_EIGHT_SWAP_HASH)) && (!in_place)) {
+			/* the image hash is verified during UPG2RUN */
+			upgr_info.img_ok = true;
+			cmd.cmd1 = CMD1_SWAP_HASH;
+			if (!tc_sha256_init(&sha)) {
+				return -EFAULT;
+			}
+		}
 		if (zb_val_img_info(&upgr_info, &upgr_slt, &run_slt)) {
 			LOG_ERR("BAD IMAGE in upgrade slot");
 			return -EINVAL;
 		}
 		(void)zb_erase(&swpstat_slt, 0, swpstat_slt.size);
-		cmd.cmd1 = CMD1_SWAP;
 		cmd.cmd2 = CMD_EMPTY;
 		cmd.cmd3 = CMD_EMPTY;
 	}
@@ -107,6 +159,12 @@ int zb_img_swap(uint8_t sm_idx) {
 			}
 			if (zb_get_img_info(&run_info, &run_slt)) {
 				LOG_INF("No move required");
+				if (cmd.cmd1 == CMD1_SWAP_HASH) {
+					/* a restore must not find a stale image
+					 * in the move slot
+					 */
+					(void)zb_erase(&move_slt, 0, sectorsize);
+				}
 				cmd.cmd2 = CMD2_UPG2RUN;
 				cmd.cmd3 = 0;
 				break;
@@ -124,6 +182,8 @@ int zb_img_swap(uint8_t sm_idx) {
 			mcmd.from = &run_slt;
 			mcmd.to = &move_slt;
 			mcmd.offset = cmd_off;
+			mcmd.sha = NULL;
+			mcmd.ctr = &zb_move_ctr;
 
 			/* erase sector in move slot */
 			zb_erase(mcmd.to, mcmd.offset, sectorsize);
@@ -149,9 +209,12 @@ int zb_img_swap(uint8_t sm_idx) {
 				break;
 			}
 			LOG_INF("UPG2RUN [sector: %d]", cmd.cmd3);
-			/* erase sector in move slot */
-			zb_erase(&run_slt, cmd_off, sectorsize);
-			if (cmd.cmd3 == 0) {
+			if ((cmd.cmd3 == 0) && (cmd.cmd1 == CMD1_SWAP_RESTORE)) {
+				if (zb_get_img_info(&upgr_info, &upgr_slt)) {
+					/* no image in the move slot */
+					upgr_info.end = cmd_off;
+				}
+			} else if (cmd.cmd3 == 0) {
 				if (!in_place) {
 					upgr_info.dep_ok = false;
 				}
@@ -164,20 +227,28 @@ int zb_img_swap(uint8_t sm_idx) {
 					(void)zb_slt_open(&upgr_slt, sm_idx,
 							  MOVE);
 					in_place = true;
+					if (cmd.cmd1 == CMD1_SWAP_HASH) {
+						zb_img_restore(&cmd,
+							       &upgr_info);
+					}
 					break;
 				}
 			} else {
 				/* Headers have been swapped */
 				(void)zb_get_img_info(&upgr_info, &run_slt);
 			}
-			if (dp_err) {
+			if ((dp_err) || (cmd.cmd1 == CMD1_SWAP_RESTORE)) {
 				/* do not decrypt dropping the old image */
 				upgr_info.enc_start = upgr_info.end;
 			}
+			/* erase sector in run slot, after the header check */
+			zb_erase(&run_slt, cmd_off, sectorsize);
 			mcmd.info = &upgr_info;
 			mcmd.from = &upgr_slt;
 			mcmd.to = &run_slt;
 			mcmd.offset = cmd_off;
+			mcmd.sha = (cmd.cmd1 == CMD1_SWAP_HASH) ? &sha : NULL;
+			mcmd.ctr = &zb_upgr_ctr;
 			if (cmd_off < upgr_info.end) {
 				/* do the move */
 				len = MIN(sectorsize, upgr_info.end - cmd_off);
@@ -185,6 +256,22 @@ int zb_img_swap(uint8_t sm_idx) {
 			} else {
 				upg2run_done = true;
 			}
+			if ((upg2run_done) && (cmd.cmd1 == CMD1_SWAP_HASH)) {
+				if ((!tc_sha256_final(hash, &sha)) ||
+				    (memcmp(hash, upgr_info.img_hash,
+					    HASH_BYTES))) {
+					LOG_ERR("BAD IMAGE HASH in upgrade slot");
+					(void)zb_slt_open(&upgr_slt, sm_idx,
+							  MOVE);
+					in_place = true;
+					mov2upg_done = true;
+					upg2run_done = false;
+					zb_img_restore(&cmd, &upgr_info);
+					break;
+				}
+				LOG_INF("Image hash OK");
+				cmd.cmd1 = CMD1_SWAP;
+			}
 			if (in_place) {
 				cmd.cmd3++;
 			} else {
@@ -224,6 +311,8 @@ int zb_img_swap(uint8_t sm_idx) {
 			mcmd.from = &move_slt;
 			mcmd.to = &upgr_slt;
 			mcmd.offset = cmd_off;
+			mcmd.sha = NULL;
+			mcmd.ctr = &zb_move_ctr;
 			if (cmd_off < move_info.end) {
 				/* do the move */
 				len = MIN(sectorsize, move_info.end - cmd_off);
@@ -252,6 +341,8 @@ int zb_img_swap(uint8_t sm_idx) {
 		}
 	}
 	LOG_INF("Finished swap");
+	memset(&zb_upgr_ctr, 0, sizeof(zb_upgr_ctr));
+	memset(&zb_move_ctr, 0, sizeof(zb_move_ctr));
 	if (dp_err) {
 		LOG_INF("Detected tampering");
 	}
@@ -259,39 +350,58 @@ int zb_img_swap(uint8_t sm_idx) {
 	return 0;
 }
 
+/* Add the part of buf (read at off) that is in the image to the hash */
+static void zb_img_move_hash(zb_move_cmd *mcmd, u32_t off, const u8_t *buf,
+			     size_t len)
+{
+	u32_t start = MAX(off, mcmd->info->start);
+	u32_t end = MIN(off + len, mcmd->info->end);
+
+	if (start < end) {
+		(void)tc_sha256_update(mcmd->sha, buf + (start - off),
+				       end - start);
+	}
+}
+
 int zb_img_move(zb_move_cmd *mcmd, size_t len)
 {
-	u8_t buf[MOVE_BLOCK_SIZE];
-	u8_t ctr[AES_KEY_SIZE] = {0U};
+	u8_t *buf = zb_work_buf;
 	u32_t ulen = 0; /* unencrypted length */
 	u32_t off;
-	int j;
+	int rc;
 
 	LOG_INF("Sector move: FR [off %x] TO [off %x]",
 		mcmd->from->offset + mcmd->offset,
 		mcmd->to->offset + mcmd->offset);
 
-	if (mcmd->offset < mcmd->info->enc_start) {
+	if (mcmd->info->enc_start >= mcmd->info->end) {
+		/* image without encryption (or a copy of the run image), the
+		 * enc_key is not set
+		 */
+		ulen = len;
+	} else if (mcmd->offset < mcmd->info->enc_start) {
 		ulen = mcmd->info->enc_start - mcmd->offset;
 	}
 
-	memcpy(ctr, mcmd->info->enc_nonce, AES_KEY_SIZE);
-
-	off = mcmd->info->enc_start;
-	while ((off < mcmd->offset) && (!ulen)) {
-		/* ctr increment is required */
-		for (j = AES_KEY_SIZE; j > 0; --j) {
-                	if (++ctr[j - 1] != 0) {
-                    		break;
-                	}
-            	}
-		off += AES_BLOCK_SIZE;
+	if (ulen < len) {
+		rc = zb_aes_ctr_init(mcmd->ctr, mcmd->info->enc_key,
+				     mcmd->info->enc_nonce);
+		if (rc) {
+			return rc;
+		}
+	}
+
+	if (!ulen) {
+		/* counter of the first block at or after offset */
+		zb_aes_ctr_seek(mcmd->ctr,
+				(mcmd->offset - mcmd->info->enc_start +
+				 AES_BLOCK_SIZE - 1) / AES_BLOCK_SIZE);
 	}
 
 	off = mcmd->offset;
 
 	while (len) {
-		size_t buf_len = MIN(len, MOVE_BLOCK_SIZE);
+		size_t buf_len = MIN(len, sizeof(zb_work_buf));
 
 		if (ulen) {
 			buf_len = MIN(buf_len, ulen);
@@ -299,9 +409,12 @@ int zb_img_move(zb_move_cmd *mcmd, size_t len)
 
 		(void)zb_read(mcmd->from, off, buf, buf_len);
 
+		if (mcmd->sha) {
+			zb_img_move_hash(mcmd, off, buf, buf_len);
+		}
+
 		if (!ulen) {
-			(void)zb_aes_ctr_mode(buf, buf_len, ctr,
-					      mcmd->info->enc_key);
+			(void)zb_aes_ctr_crypt(mcmd->ctr, buf, buf_len);
 		}
 
 		(void)zb_write(mcmd->to, off, buf, buf_len);
@@ -314,4 +427,4 @@ int zb_img_move(zb_move_cmd *mcmd, size_t len)
 	}
 
 	return 0;
-}
\ No newline at end of file
+}